@@ -7,126 +7,129 @@
  * Authors: [Team Member Names]
  */
 
-#define PI 3.14
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Include CoppeliaSim remote API
-extern "C" {
-#include "extApi.h"
-}
+// Include CoppeliaSim remote API and the shared arm session
+#include "../niryo_arm.h"
+#include "../key_transitions.h"
+#include "../ballot_reader.h"
+#include "../key_layout.h"
+#include "../ballot_journal.h"
+
+// Connection and joint handles of the arm
+NiryoArm arm;
+
+// Joint positions of every key, solved from the keypad layout before connecting
+KeySolutions keys;
+
+// Ballots already cast (--journal)
+BallotJournal journal;
 
-// Global variables
-int clientID;
-int handler;
-simxChar handlerName[150];
+// Direct moves between keys and the key the arm is working on
+Transition transitions[KEY_COUNT][KEY_COUNT];
+int lastKey = NO_KEY;
+
+// Where the key being typed started from, to type it again after a lost link
+float resumePose[KEYPAD_JOINTS];
+int resumeKey = NO_KEY;
 
 
 // Move the robotic arm to the initial position (all joints to zero)
 void InitialPosition() {
-    strcpy(handlerName, "/base_link_respondable[0]/joint_3");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(3000);
-
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(15000);
-
-    strcpy(handlerName, "/base_link_respondable[0]/joint_1");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(3000);
-
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(2000);
-}
+    arm_mark(&arm, NO_KEY);
+    lastKey = NO_KEY;
 
-
-// Move the robotic arm to a defined point (example: above number 5)
-void DefinedPoint() {
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 4, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(4000);
+    float zero[KEYPAD_JOINTS] = {0, 0, 0};
+    arm_move_planned(&arm, zero, JOINT_MASK(JOINT_3) | JOINT_MASK(JOINT_2));
+    arm_move_planned(&arm, zero, JOINT_MASK(JOINT_1));
+}
 
 
-    strcpy(handlerName, "/base_link_respondable[0]/joint_1");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 11, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(2000);
+// Move straight from the last pressed key to the next one (no trip back to the defined point)
+void GoToKey(int key) {
+    memcpy(resumePose, arm.targets, sizeof(resumePose));
+    resumeKey = lastKey;
 
+    arm_mark(&arm, key);
+    if (lastKey != NO_KEY) {
+        Transition* t = &transitions[lastKey][key];
+        arm_move_planned(&arm, t->via, KEYPAD_MASK);
+    }
+    lastKey = key;
+}
 
-    strcpy(handlerName, "/base_link_respondable[0]/joint_3");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)PI / 45, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(2000);
+// Bring the arm back after a lost link and move to the interrupted key again
+void ResumeKey(int key) {
+    if (arm_recover(&arm, resumePose) == -1) {
+        printf("ERROR: Lost the link to CoppeliaSim for good, voting stopped\n");
+        arm_disconnect(&arm);
+        exit(1);
+    }
+    lastKey = resumeKey;
+    GoToKey(key);
 }
 
-// Confirm vote sequence
-void ConfirmVote() {
+// Confirm vote sequence (a lost link fails every later move, so the last result tells;
+// ARM_PRESS_FAILED if the confirm key did not register)
+int ConfirmVote() {
     printf("Confirming vote...\n");
     
-    strcpy(handlerName, "/base_link_respondable[0]/joint_3");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 70, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(6000);
-
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 8, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(6000);
-
-    strcpy(handlerName, "/base_link_respondable[0]/joint_1");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 8, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(6000);
-
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 3.55, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(7000);
+    arm_move_planned(&arm, keys.press[KEY_CONFIRM], JOINT_MASK(JOINT_3) | JOINT_MASK(JOINT_2));
+    int pressed = arm_press_planned(&arm, KEY_CONFIRM, keys.press[KEY_CONFIRM], JOINT_MASK(JOINT_1));
+    int ret = arm_move_planned(&arm, keys.hover[KEY_CONFIRM], JOINT_MASK(JOINT_2));
+    return (ret == ARM_LINK_LOST || pressed != ARM_PRESS_FAILED) ? ret : ARM_PRESS_FAILED;
 }
 
-// Execute voting movement for a specific digit
-void Vote(float numj3, float numj2, float numj1, float backj2, int tempo1, int tempo2, int tempo3, int tempo4) {
+// Execute voting movement for a specific digit (ARM_LINK_LOST if the link dropped on the way,
+// ARM_PRESS_FAILED if the digit did not register; the arm retracts either way)
+int Vote(float numj3, float numj2, float numj1, float backj2) {
     printf("Executing vote movement...\n");
     
-    strcpy(handlerName, "/base_link_respondable[0]/joint_3");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)numj3, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(tempo1);
-
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)numj2, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(tempo2);
-
-    strcpy(handlerName, "/base_link_respondable[0]/joint_1");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)numj1, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(tempo3);
-
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)backj2, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(tempo4);
+    // Joints 3 and 2 move together, joint 1 presses only once they arrived
+    float pose[KEYPAD_JOINTS] = {numj1, numj2, numj3};
+    arm_move_planned(&arm, pose, JOINT_MASK(JOINT_3) | JOINT_MASK(JOINT_2));
+    arm.phase = PHASE_PRESS;
+    int pressed = arm_press_planned(&arm, lastKey, pose, JOINT_MASK(JOINT_1));
+
+    pose[JOINT_2] = backj2;
+    arm.phase = PHASE_RETRACT;
+    int ret = arm_move_planned(&arm, pose, JOINT_MASK(JOINT_2));
+    return (ret == ARM_LINK_LOST || pressed != ARM_PRESS_FAILED) ? ret : ARM_PRESS_FAILED;
 }
 
 int main(int argc, char* argv[]) {
     printf("=== Alternative Niryo One Controller ===\n");
-    
-    handler = 0;
 
-    // Connect to CoppeliaSim
-    clientID = simxStart((simxChar*)"127.0.0.1", 19999, true, true, 2000, 5);
-    extApi_sleepMs(500);
+    // Read options and the voting file name before connecting
+    const char* input = "voting_sequences.txt";
+    arm_init(&arm, SCENE_KEYPAD);
+    if (arm_parse_options(&arm, argc, argv, &input) == -1) {
+        return 1;
+    }
+    arm_report_on_signal(SIGUSR1);
+
+    // Joint positions of every key from its Cartesian coordinates
+    KeyLayout layout;
+    float zero[KEYPAD_JOINTS] = {0, 0, 0};
+    if (layout_open(&layout, arm.layoutFrom, SCENE_KEYPAD) == -1 ||
+        layout_solve(&layout, &NIRYO_ONE_GEOMETRY, zero, &keys) == -1) {
+        return 1;
+    }
+    arm.keyHover = keys.hover;
 
-    if (clientID == -1) {
+    // Ballots cast by an earlier run are skipped
+    if (arm.journalTo != NULL) {
+        if (journal_open(&journal, arm.journalTo) == -1) {
+            return 1;
+        }
+        printf("Journal %s: %ld ballot(s) already cast\n", arm.journalTo, journal.count);
+    }
+    
+    // Connect to CoppeliaSim and resolve the joint handles
+    if (arm_connect(&arm, arm.host, arm.port, 0) == -1) {
         printf("ERROR: Failed to connect to CoppeliaSim!\n");
         return 0;
     } else {
@@ -134,76 +137,88 @@ int main(int argc, char* argv[]) {
     }
 
     // Set central point for robot movement (above number 5)
-    strcpy(handlerName, "/base_link_respondable[0]/joint_3");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(1000);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)PI / 45, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(2000);
-
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 4, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(12000);
-
-    strcpy(handlerName, "/base_link_respondable[0]/joint_1");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 11, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(3000);
-
-    // Joint position arrays for digits 0-9
-    float numj3[] = {-PI / 35, PI / 45, PI / 20, PI / 20, PI / 150, PI / 45, PI / 30, -PI / 55, 0, PI / 200};
-    float numj2[] = {-PI / 4, -PI / 4, -PI / 4, -PI / 4, -PI / 4.5, -PI / 4, -PI / 4, -PI / 4.5, -PI / 4, -PI / 4};
-    float numj1[] = {-PI / 11, -PI / 15, -PI / 11, -PI / 10, -PI / 15, -PI / 11, -PI / 9.5, -PI / 15, -PI / 11, -PI / 9.5};
-    float backj2[] = {-PI / 3.75, -PI / 3.8, -PI / 3.6, -PI / 3.55, -PI / 3.8, -PI / 3.70, -PI / 3.6, -PI / 3.9, -PI / 3.75, -PI / 3.65};
-
-    // Timing arrays for movements (milliseconds)
-    float t1[] = {1000, 1000, 2000, 3000, 4000, 2000, 3000, 2000, 2000, 2000};
-    float t2[] = {1000, 3000, 2000, 1000, 5000, 1000, 5000, 2000, 2000, 3000};
-    float t3[] = {1000, 3000, 2000, 2000, 2000, 1000, 3000, 2000, 1000, 2000};
-    float t4[] = {1000, 3000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000};
+    const float* reference = keys.press[KEY_REFERENCE];
+    arm_move_planned(&arm, zero, JOINT_MASK(JOINT_3));
+    arm_move_planned(&arm, reference, JOINT_MASK(JOINT_3));
+    arm_move_planned(&arm, reference, JOINT_MASK(JOINT_2) | JOINT_MASK(JOINT_1));
+
+    // Joint position arrays for digits 0-9 (last entry: confirm key, used by the transition table)
+    float numj3[KEY_COUNT], numj2[KEY_COUNT], numj1[KEY_COUNT], backj2[KEY_COUNT];
+    for (int key = 0; key < KEY_COUNT; key++) {
+        numj1[key] = keys.press[key][JOINT_1];
+        numj2[key] = keys.press[key][JOINT_2];
+        numj3[key] = keys.press[key][JOINT_3];
+        backj2[key] = keys.hover[key][JOINT_2];
+    }
+
+    // Each transition replaces a trip back to the defined point
+    build_keypad_transitions(transitions, numj3, numj1, backj2, reference);
     
-    char number[10];
-    int cont = 0, len, digit;
+    BallotReader reader;
+    BallotView ballot;
+    JournalEntry entry;
+    size_t cont;
+    int ret;
 
-    FILE* file;
-    file = fopen("voting_sequences.txt", "r");
-    if (file == NULL) {
+    if (ballot_reader_open(&reader, input) == -1) {
         printf("ERROR: Failed to open file\n");
         exit(1);
     } else {
         printf("SUCCESS: File opened successfully\n");
-        while (!feof(file)) {
-            if (fscanf(file, "%s", number) == 1) {
-                len = strlen(number);
-                printf("Processing sequence: %s\n", number);
-                
-                for (cont = 0; cont < len; cont++) {
-                    digit = number[cont] - '0';  // Convert char to int
-                    
-                    if (digit >= 0 && digit <= 9) {
-                        Vote(numj3[digit], numj2[digit], numj1[digit], backj2[digit], 
-                             (int)t1[digit], (int)t2[digit], (int)t3[digit], (int)t4[digit]);
-                        
-                        // Return to defined point
-                        DefinedPoint();
-                    }
+        while (ballot_reader_next(&reader, &ballot) == 1) {
+            entry = journal_entry(ballot.offset, ballot.digits, ballot.length);
+            if (arm.journalTo != NULL && journal_contains(&journal, &entry)) {
+                printf("Already cast: %.*s\n", (int)ballot.length, ballot.digits);
+                continue;
+            }
+            printf("Processing sequence: %.*s\n", (int)ballot.length, ballot.digits);
+
+            for (cont = 0; cont < ballot.length; cont++) {
+                int digit = ballot.digits[cont] - '0';  // Convert char to int
+
+                GoToKey(digit);
+                while ((ret = Vote(numj3[digit], numj2[digit], numj1[digit], backj2[digit])) == ARM_LINK_LOST) {
+                    ResumeKey(digit);
                 }
-                
-                // Confirm vote if sequence is complete
-                if (cont == len) {
-                    ConfirmVote();
-                    DefinedPoint();  // Return to defined point
+                if (ret == ARM_PRESS_FAILED) {
+                    break;
                 }
             }
+
+            // A digit that did not register spoils the ballot: it is not confirmed
+            if (cont < ballot.length) {
+                arm_abort_ballot(&arm);
+                continue;
+            }
+
+            // Confirm vote once the whole sequence was typed
+            GoToKey(KEY_CONFIRM);
+            while ((ret = ConfirmVote()) == ARM_LINK_LOST) {
+                ResumeKey(KEY_CONFIRM);
+            }
+            if (ret == ARM_PRESS_FAILED) {
+                arm_abort_ballot(&arm);
+                continue;
+            }
+            if (arm.journalTo != NULL) {
+                journal_append(&journal, &entry);
+            }
         }
-        fclose(file);
+        ballot_reader_close(&reader);
         
         // Return to initial position
         InitialPosition();
     }
 
-    simxFinish(clientID);
+    arm_disconnect(&arm);
+    if (arm.journalTo != NULL) {
+        journal_close(&journal);
+    }
+    arm_print_stats(&arm.stats, "Latency report (ms)");
+    if (arm.stats.failedBallots > 0) {
+        printf("ERROR: %ld ballot(s) were given up after a failed press and not confirmed\n", arm.stats.failedBallots);
+        return 1;
+    }
     printf("=== Program completed successfully! ===\n");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,240 @@
+/*
+ * Compiled Ballot Cache
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ballot_cache.h"
+
+static void save_state(const MotionProgram* program, CompilerState* state) {
+    memset(state, 0, sizeof(*state));
+    state->lastKey = program->lastKey;
+    state->pendingMark = program->pendingMark;
+    state->knownMask = program->knownMask;
+    memcpy(state->commanded, program->commanded, sizeof(state->commanded));
+}
+
+static void restore_state(MotionProgram* program, const CompilerState* state) {
+    program->lastKey = state->lastKey;
+    program->pendingMark = state->pendingMark;
+    program->knownMask = state->knownMask;
+    memcpy(program->commanded, state->commanded, sizeof(program->commanded));
+}
+
+/**
+ * 64-bit FNV-1a hash of the digits followed by the start state
+ */
+static unsigned long long hash_ballot(const char* digits, size_t length, const CompilerState* start) {
+    unsigned long long hash = 14695981039346656037ULL;
+    const unsigned char* bytes = (const unsigned char*)start;
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)digits[i]) * 1099511628211ULL;
+    }
+    for (i = 0; i < sizeof(*start); i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Find an entry (cache->lock held)
+ */
+static CachedBallot* find(BallotCache* cache, unsigned long long hash, const char* digits, size_t length,
+                          const CompilerState* start) {
+    CachedBallot* entry;
+
+    for (entry = cache->buckets[hash & (cache->bucketCount - 1)]; entry != NULL; entry = entry->chain) {
+        if (entry->hash == hash && entry->length == length && memcmp(entry->digits, digits, length) == 0
+            && memcmp(&entry->start, start, sizeof(*start)) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void unlink_recency(BallotCache* cache, CachedBallot* entry) {
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+}
+
+static void push_newest(BallotCache* cache, CachedBallot* entry) {
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest != NULL) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+static void free_entry(CachedBallot* entry) {
+    free(entry->digits);
+    free(entry->steps);
+    free(entry);
+}
+
+/**
+ * Drop the least recently used entry (cache->lock held)
+ */
+static void evict_oldest(BallotCache* cache) {
+    CachedBallot* entry = cache->oldest;
+    CachedBallot** link = &cache->buckets[entry->hash & (cache->bucketCount - 1)];
+
+    while (*link != entry) {
+        link = &(*link)->chain;
+    }
+    *link = entry->chain;
+    unlink_recency(cache, entry);
+    cache->bytes -= entry->bytes;
+    cache->entries--;
+    cache->evictions++;
+    free_entry(entry);
+}
+
+/**
+ * Make room for n more steps in a program
+ * @return: 0 on success, -1 if out of memory
+ */
+static int reserve_steps(MotionProgram* program, long n) {
+    long capacity = program->capacity ? program->capacity : 256;
+    MotionStep* steps;
+
+    if (program->count + n <= program->capacity) {
+        return 0;
+    }
+    while (program->count + n > capacity) {
+        capacity *= 2;
+    }
+    steps = (MotionStep*)realloc(program->steps, capacity * sizeof(MotionStep));
+    if (steps == NULL) {
+        return -1;
+    }
+    program->steps = steps;
+    program->capacity = capacity;
+    return 0;
+}
+
+void ballot_cache_init(BallotCache* cache, size_t maxBytes) {
+    // About one bucket per 256 bytes of cap, so chains stay short when full
+    cache->bucketCount = 16;
+    while ((size_t)cache->bucketCount * 256 < maxBytes) {
+        cache->bucketCount *= 2;
+    }
+    cache->buckets = (CachedBallot**)calloc(cache->bucketCount, sizeof(CachedBallot*));
+    cache->maxBytes = cache->buckets != NULL ? maxBytes : 0;
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->bytes = 0;
+    cache->entries = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    pthread_mutex_init(&cache->lock, NULL);
+}
+
+int ballot_cache_add_ballot(BallotCache* cache, MotionProgram* program, const PoseTable* table,
+                            const char* digits, size_t length) {
+    CompilerState start;
+    CachedBallot* entry;
+    unsigned long long hash;
+    long first = program->count, merged = program->merged;
+
+    if (cache->maxBytes == 0) {
+        return program_add_ballot(program, table, digits, length);
+    }
+    save_state(program, &start);
+    hash = hash_ballot(digits, length, &start);
+
+    // Hit: copy the steps while the entry cannot be evicted
+    pthread_mutex_lock(&cache->lock);
+    entry = find(cache, hash, digits, length, &start);
+    if (entry != NULL && reserve_steps(program, entry->count) == 0) {
+        memcpy(program->steps + program->count, entry->steps, entry->count * sizeof(MotionStep));
+        program->count += entry->count;
+        program->merged += entry->merged;
+        program->ballots++;
+        restore_state(program, &entry->end);
+        unlink_recency(cache, entry);
+        push_newest(cache, entry);
+        cache->hits++;
+        pthread_mutex_unlock(&cache->lock);
+        return 0;
+    }
+    cache->misses++;
+    pthread_mutex_unlock(&cache->lock);
+
+    // Miss: compile, then keep a copy of the new steps
+    if (program_add_ballot(program, table, digits, length) == -1) {
+        return -1;
+    }
+    entry = (CachedBallot*)calloc(1, sizeof(CachedBallot));
+    if (entry == NULL) {
+        return 0;
+    }
+    entry->hash = hash;
+    entry->length = length;
+    entry->start = start;
+    save_state(program, &entry->end);
+    entry->count = program->count - first;
+    entry->merged = program->merged - merged;
+    entry->bytes = sizeof(CachedBallot) + length + entry->count * sizeof(MotionStep);
+    entry->digits = (char*)malloc(length ? length : 1);
+    entry->steps = (MotionStep*)malloc((entry->count ? entry->count : 1) * sizeof(MotionStep));
+    if (entry->digits == NULL || entry->steps == NULL || entry->bytes > cache->maxBytes) {
+        free_entry(entry);
+        return 0;
+    }
+    memcpy(entry->digits, digits, length);
+    memcpy(entry->steps, program->steps + first, entry->count * sizeof(MotionStep));
+
+    pthread_mutex_lock(&cache->lock);
+    if (find(cache, hash, digits, length, &start) != NULL) {
+        // Another thread cached the same ballot meanwhile
+        pthread_mutex_unlock(&cache->lock);
+        free_entry(entry);
+        return 0;
+    }
+    while (cache->bytes + entry->bytes > cache->maxBytes) {
+        evict_oldest(cache);
+    }
+    entry->chain = cache->buckets[hash & (cache->bucketCount - 1)];
+    cache->buckets[hash & (cache->bucketCount - 1)] = entry;
+    push_newest(cache, entry);
+    cache->bytes += entry->bytes;
+    cache->entries++;
+    pthread_mutex_unlock(&cache->lock);
+    return 0;
+}
+
+void ballot_cache_print(BallotCache* cache) {
+    pthread_mutex_lock(&cache->lock);
+    if (cache->maxBytes > 0) {
+        printf("Ballot cache: %ld hit(s), %ld miss(es), %ld eviction(s), %ld entries in %.1f of %.1f KiB\n",
+               cache->hits, cache->misses, cache->evictions, cache->entries,
+               cache->bytes / 1024.0, cache->maxBytes / 1024.0);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void ballot_cache_free(BallotCache* cache) {
+    while (cache->oldest != NULL) {
+        evict_oldest(cache);
+    }
+    free(cache->buckets);
+    cache->buckets = NULL;
+    cache->maxBytes = 0;
+    pthread_mutex_destroy(&cache->lock);
+}
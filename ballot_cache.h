@@ -0,0 +1,87 @@
+/*
+ * Compiled Ballot Cache
+ *
+ * Most ballots of an election repeat a handful of sequences, so compiling
+ * each one again plans the same moves every time. The cache keeps the motion
+ * steps a ballot compiled to, keyed by its digits and by the compiler state
+ * it started from (last key and commanded pose, which decide the transition
+ * and which joints are merged away), and appends a copy when the same ballot
+ * comes again from the same state. The result is the program plain
+ * program_add_ballot() calls would build.
+ *
+ * Entries are evicted least recently used first once the cache holds more
+ * than its memory cap. One cache serves one pose table, and it can be shared
+ * by several threads.
+ */
+
+#ifndef BALLOT_CACHE_H
+#define BALLOT_CACHE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "motion_program.h"
+
+// Compiler state before or after a ballot
+typedef struct {
+    int lastKey;                      // Key the arm is on
+    int pendingMark;                  // Mark waiting for the next step
+    int knownMask;                    // Joints whose commanded target is known
+    float commanded[MAX_JOINTS];      // Last commanded target of each joint
+} CompilerState;
+
+// One compiled ballot
+typedef struct CachedBallot {
+    unsigned long long hash;          // Hash of the digits and the start state
+    char* digits;                     // Copy of the ballot digits
+    size_t length;
+    CompilerState start;              // State the steps were compiled from
+    CompilerState end;                // State after the ballot
+    MotionStep* steps;
+    long count;                       // Steps of the ballot
+    long merged;                      // Moves merged away while compiling it
+    size_t bytes;                     // Memory charged to the entry
+    struct CachedBallot* chain;       // Next entry of the same bucket
+    struct CachedBallot* newer;       // Neighbours in the recency list
+    struct CachedBallot* older;
+} CachedBallot;
+
+typedef struct {
+    CachedBallot** buckets;           // Hash chains
+    long bucketCount;                 // Power of two
+    CachedBallot* newest;             // Most recently used entry
+    CachedBallot* oldest;             // Next entry to evict
+    size_t bytes;                     // Memory held by the entries
+    size_t maxBytes;                  // Cap (0: the cache is off)
+    long entries;
+    long hits;                        // Ballots appended from the cache
+    long misses;                      // Ballots compiled
+    long evictions;                   // Entries dropped to stay under the cap
+    pthread_mutex_t lock;
+} BallotCache;
+
+/**
+ * Start an empty cache
+ * @param maxBytes: Memory cap for the cached steps (0 turns the cache off)
+ */
+void ballot_cache_init(BallotCache* cache, size_t maxBytes);
+
+/**
+ * program_add_ballot() through the cache: append the steps cached for this
+ * ballot and compiler state, or compile the ballot and cache its steps
+ * @return: 0 on success, -1 if the ballot has a non-digit character (nothing is appended)
+ */
+int ballot_cache_add_ballot(BallotCache* cache, MotionProgram* program, const PoseTable* table,
+                            const char* digits, size_t length);
+
+/**
+ * Print the hit, miss and eviction counters and the memory in use
+ */
+void ballot_cache_print(BallotCache* cache);
+
+/**
+ * Release every entry
+ */
+void ballot_cache_free(BallotCache* cache);
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * Ballot Journal
+ *
+ * POSIX implementation: journal_open() reads the records from the start
+ * and leaves the offset after the last complete one (lseek()); records are
+ * then appended there with write() under the journal lock, the only writer,
+ * and flushed with fdatasync(). The cast ballots are kept in an
+ * open-addressing hash table keyed by their offset.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ballot_journal.h"
+
+// Start of the file
+typedef struct {
+    char magic[4];      // JOURNAL_MAGIC
+    int version;        // JOURNAL_VERSION
+} JournalHeader;
+
+// One record of the file
+typedef struct {
+    JournalEntry entry;
+    unsigned long long check;   // Hash of entry, to detect a torn record
+} JournalRecord;
+
+/**
+ * 64-bit FNV-1a hash of a byte range, continuing from seed
+ */
+static unsigned long long fnv1a(unsigned long long seed, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        seed = (seed ^ bytes[i]) * 1099511628211ULL;
+    }
+    return seed;
+}
+
+static unsigned long long record_check(const JournalEntry* entry) {
+    return fnv1a(14695981039346656037ULL ^ 0x4e424a31ULL, entry, sizeof(*entry));
+}
+
+static long long monotonic_ms() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Slot of an offset in the table: where it is, or the empty slot where it would go
+ */
+static long find_slot(const BallotJournal* journal, long long offset) {
+    long slot = (long)(((unsigned long long)offset * 11400714819323198485ULL) >> 20) & (journal->capacity - 1);
+
+    while (journal->table[slot].offset != -1 && journal->table[slot].offset != offset) {
+        slot = (slot + 1) & (journal->capacity - 1);
+    }
+    return slot;
+}
+
+/**
+ * Add a ballot to the table, doubling it when half full
+ * @return: 0 on success, -1 if out of memory
+ */
+static int insert(BallotJournal* journal, const JournalEntry* entry) {
+    JournalEntry* old = journal->table;
+    long oldCapacity = journal->capacity, i;
+
+    if ((journal->count + 1) * 2 > journal->capacity) {
+        journal->capacity = oldCapacity ? oldCapacity * 2 : 1024;
+        journal->table = (JournalEntry*)malloc(journal->capacity * sizeof(JournalEntry));
+        if (journal->table == NULL) {
+            journal->table = old;
+            journal->capacity = oldCapacity;
+            return -1;
+        }
+        for (i = 0; i < journal->capacity; i++) {
+            journal->table[i].offset = -1;
+        }
+        for (i = 0; i < oldCapacity; i++) {
+            if (old[i].offset != -1) {
+                journal->table[find_slot(journal, old[i].offset)] = old[i];
+            }
+        }
+        free(old);
+    }
+
+    i = find_slot(journal, entry->offset);
+    if (journal->table[i].offset == -1) {
+        journal->count++;
+    }
+    journal->table[i] = *entry;
+    return 0;
+}
+
+JournalEntry journal_entry(long long offset, const char* digits, size_t length) {
+    JournalEntry entry;
+
+    entry.offset = offset;
+    entry.hash = fnv1a(14695981039346656037ULL, digits, length);
+    entry.length = (long long)length;
+    return entry;
+}
+
+int journal_open(BallotJournal* journal, const char* path) {
+    JournalHeader header;
+    JournalRecord record;
+    struct stat info;
+    off_t end;
+
+    journal->table = NULL;
+    journal->capacity = 0;
+    journal->count = 0;
+    journal->unsynced = 0;
+    journal->lastSyncMs = monotonic_ms();
+    pthread_mutex_init(&journal->lock, NULL);
+
+    journal->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (journal->fd == -1 || fstat(journal->fd, &info) == -1) {
+        printf("ERROR: Could not open journal %s\n", path);
+        journal_close(journal);
+        return -1;
+    }
+
+    if (info.st_size == 0) {
+        memcpy(header.magic, JOURNAL_MAGIC, 4);
+        header.version = JOURNAL_VERSION;
+        if (write(journal->fd, &header, sizeof(header)) != (ssize_t)sizeof(header) || fdatasync(journal->fd) == -1) {
+            printf("ERROR: Could not write journal %s\n", path);
+            journal_close(journal);
+            return -1;
+        }
+    } else if (read(journal->fd, &header, sizeof(header)) != (ssize_t)sizeof(header)
+               || memcmp(header.magic, JOURNAL_MAGIC, 4) != 0 || header.version != JOURNAL_VERSION) {
+        printf("ERROR: %s is not a ballot journal of this version\n", path);
+        journal_close(journal);
+        return -1;
+    }
+
+    // Load every complete record; a torn one ends the journal
+    end = sizeof(header);
+    while (read(journal->fd, &record, sizeof(record)) == (ssize_t)sizeof(record)
+           && record.check == record_check(&record.entry) && record.entry.offset >= 0) {
+        if (insert(journal, &record.entry) == -1) {
+            printf("ERROR: Out of memory loading journal %s\n", path);
+            journal_close(journal);
+            return -1;
+        }
+        end += sizeof(record);
+    }
+    if (end < info.st_size) {
+        printf("WARNING: Dropping %lld byte(s) of an incomplete record at the end of %s\n",
+               (long long)(info.st_size - end), path);
+        if (ftruncate(journal->fd, end) == -1) {
+            printf("ERROR: Could not repair journal %s\n", path);
+            journal_close(journal);
+            return -1;
+        }
+    }
+    if (lseek(journal->fd, end, SEEK_SET) == -1) {
+        journal_close(journal);
+        return -1;
+    }
+    return 0;
+}
+
+int journal_contains(BallotJournal* journal, const JournalEntry* entry) {
+    const JournalEntry* found;
+    int contains = 0;
+
+    pthread_mutex_lock(&journal->lock);
+    if (journal->capacity > 0) {
+        found = &journal->table[find_slot(journal, entry->offset)];
+        contains = found->offset == entry->offset && found->hash == entry->hash && found->length == entry->length;
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return contains;
+}
+
+int journal_append(BallotJournal* journal, const JournalEntry* entry) {
+    JournalRecord record;
+    long long now;
+    int ret = 0;
+
+    memset(&record, 0, sizeof(record));
+    record.entry = *entry;
+    record.check = record_check(&record.entry);
+
+    pthread_mutex_lock(&journal->lock);
+    if (journal->fd == -1 || write(journal->fd, &record, sizeof(record)) != (ssize_t)sizeof(record)) {
+        ret = -1;
+    } else {
+        insert(journal, entry);
+
+        // Group commit: one flush covers every record written since the last one
+        journal->unsynced++;
+        now = monotonic_ms();
+        if (journal->unsynced >= JOURNAL_GROUP || now - journal->lastSyncMs >= JOURNAL_SYNC_MS) {
+            fdatasync(journal->fd);
+            journal->unsynced = 0;
+            journal->lastSyncMs = now;
+        }
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return ret;
+}
+
+void journal_close(BallotJournal* journal) {
+    if (journal->fd != -1) {
+        if (journal->unsynced > 0) {
+            fdatasync(journal->fd);
+        }
+        close(journal->fd);
+        journal->fd = -1;
+    }
+    free(journal->table);
+    journal->table = NULL;
+    journal->capacity = 0;
+    journal->count = 0;
+    pthread_mutex_destroy(&journal->lock);
+}
@@ -0,0 +1,78 @@
+/*
+ * Ballot Journal
+ *
+ * Append-only record of the ballots already cast, so a controller that is
+ * restarted after a crash skips them and carries on with the first ballot
+ * that was not finished. A ballot is identified by its byte offset in the
+ * voting file and a hash of its digits, so an edited file is not mistaken
+ * for the one that was journaled.
+ *
+ * Records are written as soon as a ballot is confirmed, which is enough to
+ * survive the controller dying; they are flushed to disk (fdatasync) in
+ * groups of JOURNAL_GROUP records, or sooner once JOURNAL_SYNC_MS passed
+ * since the last flush, so a power cut can only lose the last group. A
+ * record torn by a crash fails its check and is dropped, along with
+ * anything after it, when the journal is opened.
+ */
+
+#ifndef BALLOT_JOURNAL_H
+#define BALLOT_JOURNAL_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+// File signature and format version of journals
+#define JOURNAL_MAGIC "NBJ1"
+#define JOURNAL_VERSION 1
+
+// Records written before the journal is flushed to disk, and the longest time between flushes
+#define JOURNAL_GROUP 16
+#define JOURNAL_SYNC_MS 1000
+
+// One cast ballot (also the record stored in the file, followed by its check)
+typedef struct {
+    long long offset;           // Byte offset of the ballot in the voting file
+    unsigned long long hash;    // FNV-1a hash of its digits
+    long long length;           // Number of digits
+} JournalEntry;
+
+// Open journal
+typedef struct {
+    int fd;                     // File descriptor (-1 when closed)
+    pthread_mutex_t lock;       // Several arms append to the same journal
+    JournalEntry* table;        // Cast ballots, open addressing on the offset
+    long capacity;              // Slots in table (power of two)
+    long count;                 // Ballots in table
+    int unsynced;               // Records written since the last flush
+    long long lastSyncMs;       // Monotonic time of the last flush
+} BallotJournal;
+
+/**
+ * Identify a ballot of the voting file
+ */
+JournalEntry journal_entry(long long offset, const char* digits, size_t length);
+
+/**
+ * Open (or create) a journal and load the ballots it holds
+ * @return: 0 on success, -1 if the file cannot be read or written (reported with printf)
+ */
+int journal_open(BallotJournal* journal, const char* path);
+
+/**
+ * Check whether a ballot was already cast (one hash lookup)
+ * @return: 1 if the journal holds it, 0 otherwise
+ */
+int journal_contains(BallotJournal* journal, const JournalEntry* entry);
+
+/**
+ * Record a cast ballot. Safe to call from several threads.
+ * @return: 0 on success, -1 on write error
+ */
+int journal_append(BallotJournal* journal, const JournalEntry* entry);
+
+/**
+ * Flush the last records and close the file
+ */
+void journal_close(BallotJournal* journal);
+
+#endif
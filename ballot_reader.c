@@ -0,0 +1,157 @@
+/*
+ * Streaming Ballot Reader
+ *
+ * POSIX implementation: the window is an mmap of the file region around the
+ * current position. When a ballot crosses the end of the window, the window
+ * is mapped again starting at that ballot.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ballot_reader.h"
+
+/**
+ * Map the part of the file starting at offset, at least minSize bytes long
+ * @return: 0 on success, -1 on failure
+ */
+static int load_window(BallotReader* reader, long long offset, size_t minSize) {
+    long long pageSize = sysconf(_SC_PAGESIZE);
+    long long start = offset - offset % pageSize;
+    size_t size = BALLOT_WINDOW_SIZE;
+    void* window;
+
+    if (minSize + (size_t)(offset - start) > size) {
+        size = minSize + (size_t)(offset - start);
+    }
+    if ((long long)size > reader->fileSize - start) {
+        size = (size_t)(reader->fileSize - start);
+    }
+
+    if (reader->window != NULL) {
+        munmap(reader->window, reader->windowSize);
+        reader->window = NULL;
+    }
+
+    window = mmap(NULL, size, PROT_READ, MAP_PRIVATE, reader->fd, (off_t)start);
+    if (window == MAP_FAILED) {
+        printf("ERROR: Could not map voting file at offset %lld\n", start);
+        return -1;
+    }
+    madvise(window, size, MADV_SEQUENTIAL);
+
+    reader->window = (char*)window;
+    reader->windowStart = start;
+    reader->windowSize = size;
+    return 0;
+}
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+int ballot_reader_open(BallotReader* reader, const char* path) {
+    struct stat info;
+
+    reader->window = NULL;
+    reader->windowStart = 0;
+    reader->windowSize = 0;
+    reader->position = 0;
+    reader->line = 1;
+    reader->invalidLines = 0;
+
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd == -1) {
+        return -1;
+    }
+    if (fstat(reader->fd, &info) == -1) {
+        close(reader->fd);
+        reader->fd = -1;
+        return -1;
+    }
+    reader->fileSize = info.st_size;
+    return 0;
+}
+
+int ballot_reader_next(BallotReader* reader, BallotView* ballot) {
+    const char* start;
+    const char* newline;
+    size_t available, length, i;
+    long line;
+    long long offset;
+    int valid;
+
+    while (reader->position < reader->fileSize) {
+        // Make sure the window covers the next unread byte
+        if (reader->window == NULL || reader->position >= reader->windowStart + (long long)reader->windowSize) {
+            if (load_window(reader, reader->position, 0) == -1) {
+                return -1;
+            }
+        }
+
+        start = reader->window + (reader->position - reader->windowStart);
+        available = (size_t)(reader->windowStart + (long long)reader->windowSize - reader->position);
+        newline = (const char*)memchr(start, '\n', available);
+
+        // The line continues past the window: map again from the start of the line
+        if (newline == NULL && reader->windowStart + (long long)reader->windowSize < reader->fileSize) {
+            if (load_window(reader, reader->position, available + BALLOT_WINDOW_SIZE) == -1) {
+                return -1;
+            }
+            continue;
+        }
+
+        length = newline != NULL ? (size_t)(newline - start) : available;
+        line = reader->line++;
+        offset = reader->position;
+        reader->position += length + (newline != NULL ? 1 : 0);
+
+        // Trim surrounding whitespace (also handles CRLF files)
+        while (length > 0 && is_blank(start[length - 1])) {
+            length--;
+        }
+        while (length > 0 && is_blank(start[0])) {
+            start++;
+            offset++;
+            length--;
+        }
+        if (length == 0) {
+            continue;
+        }
+
+        valid = 1;
+        for (i = 0; i < length; i++) {
+            if ((unsigned char)(start[i] - '0') > 9) {
+                valid = 0;
+                break;
+            }
+        }
+        if (!valid) {
+            printf("WARNING: Line %ld: invalid character '%c' in ballot, skipping...\n", line, start[i]);
+            reader->invalidLines++;
+            continue;
+        }
+
+        ballot->digits = start;
+        ballot->length = length;
+        ballot->line = line;
+        ballot->offset = offset;
+        return 1;
+    }
+    return 0;
+}
+
+void ballot_reader_close(BallotReader* reader) {
+    if (reader->window != NULL) {
+        munmap(reader->window, reader->windowSize);
+        reader->window = NULL;
+    }
+    if (reader->fd != -1) {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+}
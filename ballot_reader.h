@@ -0,0 +1,61 @@
+/*
+ * Streaming Ballot Reader
+ *
+ * Reads a voting file one ballot (line) at a time without copying: the file
+ * is memory-mapped through a sliding window and every ballot is returned as a
+ * pointer/length view into that window. Memory use depends on the window size
+ * only, not on the size of the file, and ballots have no length limit.
+ */
+
+#ifndef BALLOT_READER_H
+#define BALLOT_READER_H
+
+#include <stddef.h>
+
+// Size of the mapped window (grows only for a single ballot longer than this)
+#ifndef BALLOT_WINDOW_SIZE
+#define BALLOT_WINDOW_SIZE (8 * 1024 * 1024)
+#endif
+
+// One ballot inside the mapped window (valid until the next call to ballot_reader_next)
+typedef struct {
+    const char* digits;   // First digit of the ballot (not null-terminated)
+    size_t length;        // Number of digits
+    long line;            // Line number in the file (1-based)
+    long long offset;     // Byte offset of the ballot in the file
+} BallotView;
+
+// State of an open voting file
+typedef struct {
+    int fd;                   // File descriptor (-1 when closed)
+    long long fileSize;       // Total file size in bytes
+    long long windowStart;    // File offset of the first byte of the window
+    size_t windowSize;        // Bytes available in the window
+    char* window;             // Mapped (or read) bytes
+    long long position;       // File offset of the next unread byte
+    long line;                // Number of the next line
+    long invalidLines;        // Lines rejected because of non-digit characters
+} BallotReader;
+
+/**
+ * Open a voting file for streaming
+ * @param path: File with one ballot per line
+ * @return: 0 on success, -1 if the file cannot be opened
+ */
+int ballot_reader_open(BallotReader* reader, const char* path);
+
+/**
+ * Return the next valid ballot. Blank lines are skipped; lines containing
+ * anything other than digits and surrounding whitespace are reported with
+ * their line number and skipped.
+ * @param ballot: Filled with a view of the ballot digits
+ * @return: 1 when a ballot was returned, 0 at end of file, -1 on read error
+ */
+int ballot_reader_next(BallotReader* reader, BallotView* ballot);
+
+/**
+ * Unmap the window and close the file
+ */
+void ballot_reader_close(BallotReader* reader);
+
+#endif
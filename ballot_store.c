@@ -0,0 +1,77 @@
+/*
+ * Ballot Store
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ballot_store.h"
+
+void ballot_store_init(BallotStore* store) {
+    store->arena = NULL;
+    store->used = 0;
+    store->capacity = 0;
+    store->ballots = NULL;
+    store->count = 0;
+    store->slots = 0;
+}
+
+int ballot_store_add(BallotStore* store, const char* digits, size_t length, long line, long long offset) {
+    StoredBallot* ballot;
+
+    // Double the arena and the records when full
+    if (store->used + length + 1 > store->capacity) {
+        size_t capacity = store->capacity ? store->capacity : 4096;
+        char* arena;
+
+        while (store->used + length + 1 > capacity) {
+            capacity *= 2;
+        }
+        arena = (char*)realloc(store->arena, capacity);
+        if (arena == NULL) {
+            return -1;
+        }
+        store->arena = arena;
+        store->capacity = capacity;
+    }
+    if (store->count == store->slots) {
+        long slots = store->slots ? store->slots * 2 : 256;
+        StoredBallot* ballots = (StoredBallot*)realloc(store->ballots, slots * sizeof(StoredBallot));
+
+        if (ballots == NULL) {
+            return -1;
+        }
+        store->ballots = ballots;
+        store->slots = slots;
+    }
+
+    ballot = &store->ballots[store->count++];
+    ballot->start = store->used;
+    ballot->length = length;
+    ballot->line = line;
+    ballot->offset = offset;
+    memcpy(store->arena + store->used, digits, length);
+    store->arena[store->used + length] = '\0';
+    store->used += length + 1;
+    return 0;
+}
+
+int ballot_store_next(const BallotStore* store, long* index, BallotView* ballot) {
+    const StoredBallot* stored;
+
+    if (*index < 0 || *index >= store->count) {
+        return 0;
+    }
+    stored = &store->ballots[(*index)++];
+    ballot->digits = store->arena + stored->start;
+    ballot->length = stored->length;
+    ballot->line = stored->line;
+    ballot->offset = stored->offset;
+    return 1;
+}
+
+void ballot_store_free(BallotStore* store) {
+    free(store->arena);
+    free(store->ballots);
+    ballot_store_init(store);
+}
@@ -0,0 +1,62 @@
+/*
+ * Ballot Store
+ *
+ * Keeps every ballot of a voting file in memory for controllers that need
+ * them all before starting (vrep.cc). The digits of all ballots live back
+ * to back in one arena, each followed by a null terminator, and a second
+ * array records where each ballot starts; both grow geometrically, so
+ * loading n ballots costs O(log n) reallocations, and the whole store is
+ * released with one call.
+ */
+
+#ifndef BALLOT_STORE_H
+#define BALLOT_STORE_H
+
+#include <stddef.h>
+
+#include "ballot_reader.h"
+
+// Where one ballot is in the arena and in the voting file
+typedef struct {
+    size_t start;         // Offset of the first digit in the arena
+    size_t length;        // Number of digits
+    long line;            // Line number in the file (1-based)
+    long long offset;     // Byte offset of the ballot in the file
+} StoredBallot;
+
+// Ballots loaded so far
+typedef struct {
+    char* arena;              // Digits of every ballot, each null-terminated
+    size_t used;              // Bytes of the arena in use
+    size_t capacity;          // Bytes allocated
+    StoredBallot* ballots;    // One record per ballot, in file order
+    long count;               // Ballots in the store
+    long slots;               // Records allocated
+} BallotStore;
+
+/**
+ * Start an empty store
+ */
+void ballot_store_init(BallotStore* store);
+
+/**
+ * Append a copy of one ballot
+ * @param digits: Ballot digits, not null terminated
+ * @return: 0 on success, -1 if out of memory (the store is left as it was)
+ */
+int ballot_store_add(BallotStore* store, const char* digits, size_t length, long line, long long offset);
+
+/**
+ * Iterate over the ballots in file order. The views stay valid until the
+ * next ballot_store_add() or ballot_store_free().
+ * @param index: Ballot to return, 0 for the first; advanced past it
+ * @return: 1 when a ballot was returned, 0 after the last one
+ */
+int ballot_store_next(const BallotStore* store, long* index, BallotView* ballot);
+
+/**
+ * Release the arena and the records (the store is left empty and reusable)
+ */
+void ballot_store_free(BallotStore* store);
+
+#endif
@@ -0,0 +1,254 @@
+/*
+ * Ballot Throughput Benchmark
+ *
+ * Runs one controller's motion logic against the in-process simulator
+ * (extapi_sim) over generated voting files and prints one JSON object per
+ * run. The controller source is linked in with its main() renamed to
+ * controller_main (see bench/run_bench.sh), so the measured code is exactly
+ * the code that drives the real arm.
+ *
+ * Per run it reports simulated time per ballot, p50/p95/p99 per-digit
+ * latency, blocking round trips per digit and total time spent sleeping.
+ * All times are simulated milliseconds; with --arms the total is the
+ * makespan of the parallel arms.
+ *
+ * Usage: bench_<controller> [--sizes 10,100,1000] [--seed N] [controller options]
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../niryo_arm.h"
+#include "../key_transitions.h"
+#include "extApiSim.h"
+
+#ifndef BENCH_CONTROLLER
+#define BENCH_CONTROLLER "controller"
+#endif
+
+// Candidate numbers used by the "popular" corpus (a few numbers dominate real elections)
+static const char* popular[] = {"12345", "99999", "13579", "54321", "24680", "11111"};
+
+// Corpora generated for every size
+static const char* corpora[] = {"uniform", "popular", "runs", "long"};
+#define CORPUS_COUNT 4
+
+int controller_main(int argc, char* argv[]);
+
+// Growing list of per-digit latencies
+typedef struct {
+    long long* values;
+    long count;
+    long capacity;
+} Samples;
+
+// Most arms told apart by the observer (instances [0]..[7])
+#define BENCH_MAX_ARMS 8
+
+// Key boundary state of one arm
+typedef struct {
+    long long markTime;
+    long long markBlocking;
+    int markKey;
+    long long ballotStart;
+} ArmMarks;
+
+// State of the run being measured (marks may come from several arm threads)
+static pthread_mutex_t markLock = PTHREAD_MUTEX_INITIALIZER;
+static ArmMarks marks[BENCH_MAX_ARMS];
+static int armsSeen;
+static Samples digitLatency;
+static long long ballotTotal;
+static long long digitBlocking;
+static long ballots;
+
+static void push_sample(Samples* samples, long long value) {
+    if (samples->count == samples->capacity) {
+        samples->capacity = samples->capacity ? samples->capacity * 2 : 1024;
+        samples->values = (long long*)realloc(samples->values, samples->capacity * sizeof(long long));
+    }
+    samples->values[samples->count++] = value;
+}
+
+static int compare_samples(const void* a, const void* b) {
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+static long long percentile(const Samples* samples, int p) {
+    long index;
+
+    if (samples->count == 0) {
+        return 0;
+    }
+    index = (long)((samples->count - 1) * (long long)p / 100);
+    return samples->values[index];
+}
+
+/**
+ * Called by arm_mark() at every key boundary: closes the interval of the
+ * previous key of that arm and opens the next one. Blocking calls are
+ * counted for the whole simulator, so they are only exact with one arm.
+ */
+static void on_mark(const NiryoArm* arm, int key) {
+    long long now = extApi_simClientTimeMs(arm->clientID);
+    long long blocking = extApi_simStats().blockingCalls;
+    ArmMarks* state;
+
+    if (arm->instance < 0 || arm->instance >= BENCH_MAX_ARMS) {
+        return;
+    }
+    pthread_mutex_lock(&markLock);
+    state = &marks[arm->instance];
+    if (arm->instance >= armsSeen) {
+        armsSeen = arm->instance + 1;
+    }
+
+    if (state->markKey >= 0 && state->markKey <= 9) {
+        push_sample(&digitLatency, now - state->markTime);
+        digitBlocking += blocking - state->markBlocking;
+    } else if (state->markKey == KEY_CONFIRM && state->ballotStart >= 0) {
+        ballotTotal += now - state->ballotStart;
+        ballots++;
+        state->ballotStart = -1;
+    }
+
+    if (key != NO_KEY && state->ballotStart < 0) {
+        state->ballotStart = now;
+    }
+    state->markKey = key;
+    state->markTime = now;
+    state->markBlocking = blocking;
+    pthread_mutex_unlock(&markLock);
+}
+
+/**
+ * Write a voting file of the given shape
+ */
+static void generate_corpus(const char* path, const char* corpus, long size) {
+    FILE* file = fopen(path, "w");
+    long b;
+    int length, d;
+
+    for (b = 0; b < size; b++) {
+        if (strcmp(corpus, "popular") == 0) {
+            // Skewed: the first candidates get most of the votes
+            int pick = rand() % 100;
+            fprintf(file, "%s\n", popular[pick < 40 ? 0 : pick < 65 ? 1 : pick < 80 ? 2 : pick < 90 ? 3 : pick < 96 ? 4 : 5]);
+        } else if (strcmp(corpus, "runs") == 0) {
+            fprintf(file, "%05d\n", (rand() % 10) * 11111);
+        } else {
+            length = strcmp(corpus, "long") == 0 ? 1 + rand() % 20 : 5;
+            for (d = 0; d < length; d++) {
+                fputc('0' + rand() % 10, file);
+            }
+            fputc('\n', file);
+        }
+    }
+    fclose(file);
+}
+
+/**
+ * Run the controller once on a voting file with its console output silenced
+ */
+static void run_controller(const char* path, int argc, char* argv[]) {
+    char** args = (char**)malloc((argc + 2) * sizeof(char*));
+    int saved, devnull, i;
+
+    args[0] = (char*)BENCH_CONTROLLER;
+    for (i = 0; i < argc; i++) {
+        args[i + 1] = argv[i];
+    }
+    args[argc + 1] = (char*)path;
+
+    fflush(stdout);
+    saved = dup(STDOUT_FILENO);
+    devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+
+    controller_main(argc + 2, args);
+
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    free(args);
+}
+
+int main(int argc, char* argv[]) {
+    long sizes[16] = {10, 100, 1000};
+    int sizeCount = 3;
+    unsigned int seed = 1;
+    char* passThrough[32];
+    int passCount = 0;
+    char path[64];
+    int i, s, c;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            char* item = strtok(argv[++i], ",");
+            for (sizeCount = 0; item != NULL && sizeCount < 16; item = strtok(NULL, ",")) {
+                sizes[sizeCount++] = atol(item);
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned int)atoi(argv[++i]);
+        } else if (passCount < 32) {
+            passThrough[passCount++] = argv[i];
+        }
+    }
+
+    snprintf(path, sizeof(path), "/tmp/ballot_bench_%d.txt", (int)getpid());
+    arm_mark_observer = on_mark;
+
+    for (s = 0; s < sizeCount; s++) {
+        for (c = 0; c < CORPUS_COUNT; c++) {
+            clock_t cpuStart;
+            long long sleepMs, blockingCalls, simMs;
+
+            srand(seed);
+            generate_corpus(path, corpora[c], sizes[s]);
+
+            // Fresh scene, counters and measurement state for every run
+            extApi_simReset();
+            extApi_simResetStats();
+            digitLatency.count = 0;
+            for (i = 0; i < BENCH_MAX_ARMS; i++) {
+                marks[i].markKey = NO_KEY;
+                marks[i].ballotStart = -1;
+            }
+            armsSeen = 0;
+            ballotTotal = 0;
+            digitBlocking = 0;
+            ballots = 0;
+
+            cpuStart = clock();
+            run_controller(path, passCount, passThrough);
+            simMs = extApi_simTimeMs();
+            sleepMs = extApi_simStats().sleepMs;
+            blockingCalls = extApi_simStats().blockingCalls;
+
+            qsort(digitLatency.values, digitLatency.count, sizeof(long long), compare_samples);
+            printf("{\"controller\":\"%s\",\"corpus\":\"%s\",\"arms\":%d,\"ballots\":%ld,\"digits\":%ld,"
+                   "\"sim_ms_total\":%lld,\"sim_ms_per_ballot\":%.1f,"
+                   "\"digit_p50_ms\":%lld,\"digit_p95_ms\":%lld,\"digit_p99_ms\":%lld,"
+                   "\"blocking_per_digit\":%.2f,\"blocking_total\":%lld,\"sleep_ms_total\":%lld,"
+                   "\"cpu_ms\":%.1f}\n",
+                   BENCH_CONTROLLER, corpora[c], armsSeen, ballots, digitLatency.count,
+                   simMs, ballots ? (double)ballotTotal / ballots : 0.0,
+                   percentile(&digitLatency, 50), percentile(&digitLatency, 95), percentile(&digitLatency, 99),
+                   digitLatency.count ? (double)digitBlocking / digitLatency.count : 0.0, blockingCalls, sleepMs,
+                   (double)(clock() - cpuStart) * 1000 / CLOCKS_PER_SEC);
+            fflush(stdout);
+        }
+    }
+
+    unlink(path);
+    free(digitLatency.values);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#!/bin/sh
+# Check the joint commands that follow a given-up ballot. Every contact is
+# lost (EXTAPI_SIM_MISS_EVERY=1), so each ballot is given up on its first
+# press. The next ballot must still start from the pose its steps were
+# compiled for. The commanded poses of a direct run, where ballots are cast
+# one program at a time, must match those of the same ballots compiled whole
+# with --compile and run with --program. The --arms workers are checked the
+# same way: each arm against a --program run of the ballots it cast (which
+# arm takes which ballot depends on thread timing, an arm that cast none is
+# skipped).
+#
+# Usage: bench/check_resync.sh
+
+set -e
+cd "$(dirname "$0")/.."
+
+CXX=${CXX:-g++}
+OUT=${BENCH_BUILD_DIR:-/tmp/niryo_bench}/resync
+FLAGS="-O2 -Iextapi_sim"
+SHARED="niryo_arm.c niryo_clock.c key_transitions.c motion_program.c trajectory.c kinematics.c key_layout.c histogram.c joint_trace.c ballot_journal.c ballot_reader.c ballot_store.c ballot_cache.c call_log.c extapi_sim/extApi.c"
+FAILED=0
+
+mkdir -p "$OUT"
+$CXX $FLAGS -x c++ niryo_controller.c $SHARED -o "$OUT/niryo_controller" -lpthread
+$CXX $FLAGS -x c++ vrep.cc $SHARED -o "$OUT/vrep" -lpthread
+$CXX $FLAGS -x c++ trace_dump.c joint_trace.c -o "$OUT/trace_dump"
+
+export EXTAPI_SIM_MISS_EVERY=1
+printf '12345\n99999\n' > "$OUT/two.txt"
+printf '12345\n99999\n24680\n13579\n12345\n99999\n24680\n13579\n' > "$OUT/eight.txt"
+
+# Commanded poses of a trace, one line each time they change
+commands() {
+    "$OUT/trace_dump" "$1" | awk -F, -v joints="$2" 'NR > 1 {
+        pose = $4; for (j = 5; j < 4 + joints; j++) pose = pose "," $j
+        if (pose != last) print pose; last = pose }'
+}
+
+# Compare two traces, report the first differing command
+check() {
+    commands "$2" "$4" > "$OUT/got.txt"
+    commands "$3" "$4" > "$OUT/want.txt"
+    if cmp -s "$OUT/got.txt" "$OUT/want.txt"; then
+        echo "PASS: $1"
+    else
+        echo "FAIL: $1"
+        diff "$OUT/got.txt" "$OUT/want.txt" | head -6
+        FAILED=1
+    fi
+}
+
+# Direct run against the whole program (the failed ballot is the last of its program)
+for name in niryo_controller vrep; do
+    joints=3
+    [ "$name" = vrep ] && joints=6
+    "$OUT/$name" --detect-press --clock sync --trace "$OUT/direct.trace" "$OUT/two.txt" > /dev/null || true
+    "$OUT/$name" --compile "$OUT/two.bin" "$OUT/two.txt" > /dev/null
+    "$OUT/$name" --detect-press --clock sync --program "$OUT/two.bin" --trace "$OUT/program.trace" > /dev/null || true
+    check "$name direct run after a given-up ballot" "$OUT/direct.trace" "$OUT/program.trace" $joints
+    rm -f "$OUT/direct.trace" "$OUT/program.trace"
+done
+
+# --arms workers against a program of the ballots each arm cast
+"$OUT/niryo_controller" --detect-press --arms 2 --trace "$OUT/arms.trace" "$OUT/eight.txt" > "$OUT/arms.log" || true
+for arm in 0 1; do
+    sed -n "s/^Arm \[$arm\] casting voting sequence: //p" "$OUT/arms.log" > "$OUT/arm$arm.txt"
+    if [ ! -s "$OUT/arm$arm.txt" ]; then
+        echo "SKIP: --arms worker [$arm] cast no ballot"
+        rm -f "$OUT/arms.trace.$arm"
+        continue
+    fi
+    "$OUT/niryo_controller" --compile "$OUT/arm$arm.bin" "$OUT/arm$arm.txt" > /dev/null
+    "$OUT/niryo_controller" --detect-press --program "$OUT/arm$arm.bin" --trace "$OUT/program.trace" > /dev/null || true
+    check "--arms worker [$arm] after a given-up ballot" "$OUT/arms.trace.$arm" "$OUT/program.trace" 3
+    rm -f "$OUT/arms.trace.$arm" "$OUT/program.trace"
+done
+
+exit $FAILED
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Build the three controllers against the in-process simulator and benchmark them.
+# Prints one JSON object per (controller, corpus, size) run; extra arguments
+# (e.g. --sizes 10,100 or --fixed-dwell) are passed to every benchmark.
+#
+# Usage: bench/run_bench.sh [--sizes 10,100,1000] [--seed N] [controller options] > results.jsonl
+
+set -e
+cd "$(dirname "$0")/.."
+
+CXX=${CXX:-g++}
+OUT=${BENCH_BUILD_DIR:-/tmp/niryo_bench}
+FLAGS="-O2 -Iextapi_sim"
+SHARED="niryo_arm.c niryo_clock.c key_transitions.c motion_program.c trajectory.c kinematics.c key_layout.c histogram.c joint_trace.c ballot_journal.c ballot_reader.c ballot_store.c ballot_cache.c call_log.c extapi_sim/extApi.c"
+
+mkdir -p "$OUT"
+
+build() {
+    name=$1
+    source=$2
+    $CXX $FLAGS -Dmain=controller_main -x c++ -c "$source" -o "$OUT/$name.o"
+    $CXX $FLAGS -DBENCH_CONTROLLER="\"$name\"" -x c++ bench/ballot_bench.c $SHARED -x none "$OUT/$name.o" -o "$OUT/bench_$name" -lpthread
+}
+
+build niryo_controller niryo_controller.c
+build main Main/main.c
+build vrep vrep.cc
+
+for name in niryo_controller main vrep; do
+    "$OUT/bench_$name" "$@"
+done
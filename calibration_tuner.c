@@ -0,0 +1,462 @@
+/*
+ * Keypad Calibration Tuner
+ *
+ * Searches, for every key of the keypad scene, how far the shoulder has to
+ * lift the tool off the key after a press, and how long every planned move
+ * needs to settle, for the fastest settings that still press reliably.
+ * Candidates are evaluated on several arms at once: arm [i] on port
+ * --port + i (19999 + i by default) of one scene (the in-process stand-in,
+ * or a scene with several keypads), or arm [0] of a separate CoppeliaSim
+ * instance on each port with --separate-scenes.
+ *
+ * Each candidate retract height is tried on a press cycle from above the
+ * reference key (approach, press, retract). The press is watched on the
+ * keypad signal, as with --detect-press (always on here). A candidate
+ * passes when the keypad registers the key itself on the first press,
+ * every other phase reaches its pose, and the retracted tool is at least
+ * --clearance metres off the key. The time a phase took beyond its planned
+ * profile is the settle time the candidate needs. The fastest passing
+ * height of each key is kept, and the settle time becomes the largest one
+ * they need. A last pass replays every key with fixed dwells. It checks
+ * that each press registers and that each other phase lands before its
+ * dwell ends, raising the settle time until it does. The result is written
+ * as a key layout the controllers load with --layout.
+ *
+ * Usage: calibration_tuner [--arms <n>] [--separate-scenes] [--clearance <m>]
+ *                          [--layout <start layout>] [--tolerance <rad>] [--clock real|sync] [output file]
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "niryo_arm.h"
+#include "key_layout.h"
+#include "trajectory.h"
+
+// Retract heights tried per key: 1/LIFT_STEPS .. LIFT_STEPS/LIFT_STEPS of the calibrated lift
+#define LIFT_STEPS 8
+
+// Phases of a press cycle: approach, press, retract
+#define CYCLE_PHASES 3
+#define PRESS_PHASE 1
+
+// Smallest distance between the tool on the key and the retracted tool (metres)
+#define DEFAULT_CLEARANCE 0.01f
+
+// Settle times are rounded up to, and raised by, this step while verifying
+#define SETTLE_STEP_MS 10
+#define MAX_SETTLE_MS 1000
+
+// Extra time a measured phase may take beyond its profile before it counts as failed
+#define MEASURE_MARGIN_MS 5000
+
+// Work handed out to the arms
+enum TunerPass {
+    PASS_MEASURE = 0,    // One item per (key, retract height) candidate
+    PASS_VERIFY = 1      // One item per key, with the chosen heights and settle time
+};
+
+// Outcome of one retract height of one key
+typedef struct {
+    float liftJ2;        // Joint 2 after the retract (radians)
+    float clearance;     // Distance from the tool on the key to the retracted tool (metres)
+    int tried;           // 1 once the candidate ran on an arm
+    int pressed;         // 1 if the key registered on its first press and every other phase reached its pose
+    int settleMs;        // Longest time a phase needed beyond its profile
+} Candidate;
+
+// One arm evaluating candidates
+typedef struct {
+    NiryoArm arm;            // Session of this arm (options copied from the command line)
+    pthread_t thread;
+    int connected;           // 1 once the arm reached its reference point
+    long items;              // Candidates or keys evaluated by this arm
+} TunerWorker;
+
+// Options shared by every arm, and the tuner's own
+NiryoArm options;
+int separateScenes = 0;
+float clearance = DEFAULT_CLEARANCE;
+
+// Joint positions of the keys being tuned and the reference point the cycles start from
+KeySolutions keys;
+const float* reference;
+
+Candidate candidates[KEY_COUNT][LIFT_STEPS];
+int chosen[KEY_COUNT];               // Candidate kept for each key
+int verifyFailed[KEY_COUNT];         // 1 if a phase did not land within its dwell
+int pressFailed[KEY_COUNT];          // 1 if the keypad missed the key or registered another one while verifying
+
+// Work queue of the current pass
+int pass;
+int itemCount, nextItem;
+pthread_mutex_t workLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Take the next item of the current pass
+ * @return: Item index, or -1 once the pass is done
+ */
+int next_item() {
+    int item = -1;
+
+    pthread_mutex_lock(&workLock);
+    if (nextItem < itemCount) {
+        item = nextItem++;
+    }
+    pthread_mutex_unlock(&workLock);
+    return item;
+}
+
+/**
+ * Pose of a key's press cycle phase: on the key, or retracted to liftJ2
+ */
+void cycle_pose(int key, int phase, float liftJ2, float* pose) {
+    memcpy(pose, keys.press[key], KEYPAD_JOINTS * sizeof(float));
+    if (phase == CYCLE_PHASES - 1) {
+        pose[JOINT_2] = liftJ2;
+    }
+}
+
+// Joints moved by each phase of a press cycle (same order as build_pose_table() in niryo_controller.c)
+static const int CYCLE_MASKS[CYCLE_PHASES] = {
+    JOINT_MASK(JOINT_3) | JOINT_MASK(JOINT_2), JOINT_MASK(JOINT_1), JOINT_MASK(JOINT_2)
+};
+
+/**
+ * Planned profile of a press cycle from the reference point, without settling
+ * @return: Milliseconds
+ */
+int cycle_profile_ms(int key, float liftJ2) {
+    float from[KEYPAD_JOINTS], to[KEYPAD_JOINTS];
+    Trajectory trajectory;
+    int phase, total = 0;
+
+    memcpy(from, reference, sizeof(from));
+    for (phase = 0; phase < CYCLE_PHASES; phase++) {
+        cycle_pose(key, phase, liftJ2, to);
+        total += (int)ceilf(plan_move(&trajectory, from, to, CYCLE_MASKS[phase], &NIRYO_ONE_LIMITS) * 1000);
+        memcpy(from, to, sizeof(from));
+    }
+    return total;
+}
+
+/**
+ * Check that the masked joints sit within tolerance of their last targets
+ */
+int joints_arrived(NiryoArm* arm, int mask) {
+    float position;
+    int j;
+
+    for (j = 0; j < arm->jointCount; j++) {
+        if ((mask & JOINT_MASK(j)) &&
+            (Link::read_position(arm->clientID, arm->handles[j], &position) != simx_return_ok
+             || fabsf(position - arm->targets[j]) > arm->tolerance)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Press phase of a cycle, watched on the keypad signal
+ * @return: 1 if the keypad registered the key itself on the first press; 0 on a miss,
+ *          another key, a press made again by arm_press() or no signal to tell
+ */
+int press_key(NiryoArm* arm, int key, const float* pose, int timeout_ms) {
+    long retries = arm->stats.pressRetries;
+
+    // Without a signal value arm_press() would only move to the pose
+    if (arm->pressBaseline < 0) {
+        return 0;
+    }
+    return arm_press(arm, key, pose, CYCLE_MASKS[PRESS_PHASE], timeout_ms) == 0 && arm->stats.pressRetries == retries;
+}
+
+/**
+ * Run one press cycle while timing every phase against its profile
+ */
+void measure_candidate(NiryoArm* arm, int key, Candidate* candidate) {
+    float pose[KEYPAD_JOINTS];
+    Trajectory trajectory;
+    int phase, planned, beyond;
+    long long start;
+
+    arm->waitMode = WAIT_CONVERGE;
+    arm_move_planned(arm, reference, KEYPAD_MASK);
+    arm_mark(arm, key);
+
+    candidate->pressed = 1;
+    candidate->settleMs = 0;
+    for (phase = 0; phase < CYCLE_PHASES && candidate->pressed; phase++) {
+        cycle_pose(key, phase, candidate->liftJ2, pose);
+        planned = (int)ceilf(plan_move(&trajectory, arm->targets, pose, CYCLE_MASKS[phase], &NIRYO_ONE_LIMITS) * 1000);
+
+        // The press phase ends once the keypad registers the key
+        start = clock_now_ms(&arm->clock);
+        if (phase == PRESS_PHASE) {
+            candidate->pressed = press_key(arm, key, pose, planned + MEASURE_MARGIN_MS);
+        } else {
+            candidate->pressed = arm_move_pose(arm, pose, CYCLE_MASKS[phase], planned + MEASURE_MARGIN_MS) == 0;
+        }
+        if (!candidate->pressed) {
+            break;
+        }
+        beyond = (int)(clock_now_ms(&arm->clock) - start) - planned;
+        if (beyond > candidate->settleMs) {
+            candidate->settleMs = beyond;
+        }
+    }
+    candidate->tried = 1;
+}
+
+/**
+ * Replay a key's press cycle with fixed dwells: the press must register the
+ * key itself, every other phase must land in time
+ */
+void verify_key(NiryoArm* arm, int key) {
+    float pose[KEYPAD_JOINTS];
+    int phase;
+
+    arm->waitMode = WAIT_CONVERGE;
+    arm_move_planned(arm, reference, KEYPAD_MASK);
+    arm_mark(arm, key);
+
+    arm->waitMode = WAIT_FIXED;
+    verifyFailed[key] = 0;
+    pressFailed[key] = 0;
+    for (phase = 0; phase < CYCLE_PHASES && !verifyFailed[key] && !pressFailed[key]; phase++) {
+        cycle_pose(key, phase, candidates[key][chosen[key]].liftJ2, pose);
+        if (phase == PRESS_PHASE) {
+            // The dwell ends on the press, so the keypad tells rather than the joints
+            pressFailed[key] = !press_key(arm, key, pose,
+                                          plan_duration_ms(arm->targets, pose, CYCLE_MASKS[phase], &NIRYO_ONE_LIMITS));
+        } else {
+            arm_move_planned(arm, pose, CYCLE_MASKS[phase]);
+            verifyFailed[key] = !joints_arrived(arm, CYCLE_MASKS[phase]);
+        }
+    }
+}
+
+/**
+ * Thread of one arm: evaluate items of the current pass until the queue is empty
+ */
+void* tuner_worker(void* data) {
+    TunerWorker* worker = (TunerWorker*)data;
+    NiryoArm* session = &worker->arm;
+    int instance = worker->arm.instance;
+    int port = session->port + instance;
+    int item;
+
+    if (arm_connect(session, session->host, port, separateScenes ? 0 : instance) == -1) {
+        printf("ERROR: Arm %d could not connect on port %d, its candidates go to the other arms\n", instance, port);
+        return NULL;
+    }
+    worker->connected = 1;
+
+    while ((item = next_item()) >= 0) {
+        if (pass == PASS_MEASURE) {
+            Candidate* candidate = &candidates[item / LIFT_STEPS][item % LIFT_STEPS];
+            if (candidate->clearance >= clearance) {
+                measure_candidate(session, item / LIFT_STEPS, candidate);
+            }
+        } else {
+            verify_key(session, item);
+        }
+        worker->items++;
+    }
+
+    // Leave the arm at rest for the next pass
+    float zero[KEYPAD_JOINTS] = {0, 0, 0};
+    session->waitMode = WAIT_CONVERGE;
+    arm_move_planned(session, zero, KEYPAD_MASK);
+    arm_disconnect(session);
+    return NULL;
+}
+
+/**
+ * Share the items of a pass between the arms
+ * @return: 0 on success, -1 if no arm connected
+ */
+int run_pass(int which, int items) {
+    TunerWorker* workers = (TunerWorker*)calloc(options.arms, sizeof(TunerWorker));
+    int i, connected = 0;
+
+    pass = which;
+    itemCount = items;
+    nextItem = 0;
+    for (i = 0; i < options.arms; i++) {
+        workers[i].arm = options;
+        workers[i].arm.instance = i;
+        pthread_create(&workers[i].thread, NULL, tuner_worker, &workers[i]);
+    }
+    for (i = 0; i < options.arms; i++) {
+        pthread_join(workers[i].thread, NULL);
+        connected += workers[i].connected;
+    }
+
+    free(workers);
+    if (connected == 0) {
+        printf("ERROR: No arm connected\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Distance between the tool on a key and the tool retracted to liftJ2
+ */
+float retract_clearance(int key, float liftJ2) {
+    float retracted[KEYPAD_JOINTS];
+    CartesianPose on, off;
+    float dx, dy, dz;
+
+    forward_kinematics(&NIRYO_ONE_GEOMETRY, keys.press[key], KEYPAD_JOINTS, &on);
+    cycle_pose(key, CYCLE_PHASES - 1, liftJ2, retracted);
+    forward_kinematics(&NIRYO_ONE_GEOMETRY, retracted, KEYPAD_JOINTS, &off);
+    dx = off.position[0] - on.position[0];
+    dy = off.position[1] - on.position[1];
+    dz = off.position[2] - on.position[2];
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+/**
+ * Main program function
+ */
+int main(int argc, char* argv[]) {
+    const char* output = "keypad_layout.txt";
+    char** controllerArgs = (char**)malloc(argc * sizeof(char*));
+    int controllerArgc = 1, i, key, step, settle = 0, failed, missed;
+    float zero[MAX_JOINTS] = {0};
+    KeyLayout layout;
+
+    printf("=== Niryo One Keypad Calibration Tuner ===\n");
+
+    // Tuner options first, the rest are the controllers' options
+    controllerArgs[0] = argv[0];
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--separate-scenes") == 0) {
+            separateScenes = 1;
+        } else if (strcmp(argv[i], "--clearance") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0) {
+            clearance = (float)atof(argv[++i]);
+        } else {
+            controllerArgs[controllerArgc++] = argv[i];
+        }
+    }
+    arm_init(&options, SCENE_KEYPAD);
+    if (arm_parse_options(&options, controllerArgc, controllerArgs, &output) == -1) {
+        free(controllerArgs);
+        return 1;
+    }
+    free(controllerArgs);
+    if (options.compileTo != NULL || options.programFrom != NULL || options.clock.mode == CLOCK_VIRTUAL ||
+        (options.clock.mode == CLOCK_SYNC && options.arms > 1)) {
+        printf("ERROR: The tuner measures the arms: --compile, --program, --clock virtual and --clock sync with --arms do not apply\n");
+        return 1;
+    }
+
+    // Start from the built-in layout or the one given with --layout
+    if (layout_open(&layout, options.layoutFrom, SCENE_KEYPAD) == -1 ||
+        layout_solve(&layout, &NIRYO_ONE_GEOMETRY, zero, &keys) == -1) {
+        return 1;
+    }
+
+    // Cycles start above the reference key, so its own cycle presses it too
+    reference = keys.hover[KEY_REFERENCE];
+    options.keyHover = keys.hover;
+    options.detectPress = 1;
+
+    // Candidate retract heights, from the smallest lift to the calibrated one
+    for (key = 0; key < KEY_COUNT; key++) {
+        for (step = 0; step < LIFT_STEPS; step++) {
+            Candidate* candidate = &candidates[key][step];
+            float lift = keys.hover[key][JOINT_2] - keys.press[key][JOINT_2];
+
+            memset(candidate, 0, sizeof(*candidate));
+            candidate->liftJ2 = keys.press[key][JOINT_2] + lift * (step + 1) / LIFT_STEPS;
+            candidate->clearance = retract_clearance(key, candidate->liftJ2);
+        }
+    }
+
+    printf("Measuring %d retract heights of %d keys on %d arm(s)...\n", LIFT_STEPS, KEY_COUNT, options.arms);
+    if (run_pass(PASS_MEASURE, KEY_COUNT * LIFT_STEPS) == -1) {
+        return 1;
+    }
+
+    // Fastest passing height of each key; the calibrated height if none passes
+    for (key = 0; key < KEY_COUNT; key++) {
+        int bestCost = -1;
+
+        chosen[key] = LIFT_STEPS - 1;
+        for (step = 0; step < LIFT_STEPS; step++) {
+            Candidate* candidate = &candidates[key][step];
+            int cost = cycle_profile_ms(key, candidate->liftJ2) + CYCLE_PHASES * candidate->settleMs;
+
+            if (candidate->tried && candidate->pressed && (bestCost == -1 || cost < bestCost)) {
+                bestCost = cost;
+                chosen[key] = step;
+            }
+        }
+        if (bestCost == -1) {
+            printf("WARNING: No retract height of key %d passed, keeping the calibrated one\n", key);
+        }
+        if (candidates[key][chosen[key]].settleMs > settle) {
+            settle = candidates[key][chosen[key]].settleMs;
+        }
+    }
+    settle = (settle + SETTLE_STEP_MS - 1) / SETTLE_STEP_MS * SETTLE_STEP_MS;
+
+    // Replay every key with fixed dwells, raising the settle time until all of them land
+    do {
+        printf("Verifying %d keys with a settle time of %d ms...\n", KEY_COUNT, settle);
+        plan_set_settle_ms(settle);
+        if (run_pass(PASS_VERIFY, KEY_COUNT) == -1) {
+            return 1;
+        }
+        failed = 0;
+        missed = 0;
+        for (key = 0; key < KEY_COUNT; key++) {
+            failed += verifyFailed[key];
+            missed += pressFailed[key];
+        }
+        if (missed > 0) {
+            printf("ERROR: %d key(s) were missed or registered another key while verifying, nothing written\n", missed);
+            return 1;
+        }
+        if (failed > 0) {
+            settle += SETTLE_STEP_MS;
+        }
+    } while (failed > 0 && settle <= MAX_SETTLE_MS);
+
+    if (failed > 0) {
+        printf("ERROR: %d key(s) still miss their dwell with a settle time of %d ms, nothing written\n", failed, MAX_SETTLE_MS);
+        return 1;
+    }
+
+    // Write the tuned retract poses and settle time
+    printf("\nKey  Lift  Clearance (mm)  Cycle before (ms)  Cycle after (ms)\n");
+    for (key = 0; key < KEY_COUNT; key++) {
+        Candidate* candidate = &candidates[key][chosen[key]];
+        float retracted[KEYPAD_JOINTS];
+        CartesianPose pose;
+
+        cycle_pose(key, CYCLE_PHASES - 1, candidate->liftJ2, retracted);
+        forward_kinematics(&NIRYO_ONE_GEOMETRY, retracted, KEYPAD_JOINTS, &pose);
+        memcpy(layout.hover[key].position, pose.position, sizeof(pose.position));
+
+        printf("%3d  %d/%d  %14.1f  %17d  %16d\n", key, chosen[key] + 1, LIFT_STEPS, candidate->clearance * 1000,
+               cycle_profile_ms(key, keys.hover[key][JOINT_2]) + CYCLE_PHASES * layout.settleMs,
+               cycle_profile_ms(key, candidate->liftJ2) + CYCLE_PHASES * settle);
+    }
+    layout.settleMs = settle;
+
+    if (layout_save(&layout, output) == -1) {
+        printf("ERROR: Could not write %s\n", output);
+        return 1;
+    }
+    printf("SUCCESS: Tuned layout written to %s (settle time %d ms); run the controllers with --layout %s\n",
+           output, settle, output);
+    return 0;
+}
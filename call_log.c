@@ -0,0 +1,458 @@
+/*
+ * Remote Call Log
+ */
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "call_log.h"
+
+// Return codes of the remote API
+extern "C" {
+#include "extApi.h"
+}
+
+static const char* CALL_NAMES[LOG_CALL_COUNT] = {
+    "connect", "disconnect", "connection id", "get handle", "set target", "stream position",
+    "read position", "query position", "stream signal", "read signal", "pause", "ping",
+    "synchronous", "trigger", "sleep"
+};
+
+FILE* callRecording = NULL;
+static pthread_mutex_t recordLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Most ports a replay hands connections out for
+#define REPLAY_MAX_PORTS 64
+
+// Loaded log of the replay backend
+static CallRecord* records = NULL;
+static long recordCount = 0;
+static long* order = NULL;                 // Record indexes by lookup group, client, key, then time
+static int replaySpeed = REPLAY_FAST;
+static int cursorPorts[REPLAY_MAX_PORTS];  // Connections already handed out, per port
+static int cursorUsed[REPLAY_MAX_PORTS];
+static int cursorCount = 0;
+static pthread_mutex_t replayLock = PTHREAD_MUTEX_INITIALIZER;
+static thread_local long long replayClock = -1;   // Replay time of this thread (-1 before its first connect)
+
+int call_log_name_key(const char* name) {
+    unsigned int hash = 2166136261u;
+
+    while (*name != '\0') {
+        hash = (hash ^ (unsigned char)*name++) * 16777619u;
+    }
+    return (int)hash;
+}
+
+static int has_position(int call) {
+    return call == LOG_SET_TARGET || call == LOG_READ_POSITION || call == LOG_QUERY_POSITION;
+}
+
+static void close_recording(void) {
+    pthread_mutex_lock(&recordLock);
+    if (callRecording != NULL) {
+        fclose(callRecording);
+        callRecording = NULL;
+    }
+    pthread_mutex_unlock(&recordLock);
+}
+
+int call_log_record(const char* path, const char* backend) {
+    CallLogHeader header;
+    FILE* file = fopen(path, "wb");
+
+    if (file == NULL) {
+        printf("ERROR: Could not write call log %s\n", path);
+        return -1;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CALL_LOG_MAGIC, 4);
+    header.version = CALL_LOG_VERSION;
+    header.recordSize = sizeof(CallRecord);
+    strncpy(header.backend, backend, sizeof(header.backend) - 1);
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        printf("ERROR: Could not write call log %s\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    close_recording();
+    pthread_mutex_lock(&recordLock);
+    callRecording = file;
+    pthread_mutex_unlock(&recordLock);
+    atexit(close_recording);
+    return 0;
+}
+
+void call_log_write(int call, long long startMs, long long endMs, int clientID, int key, int ret,
+                    int integer, float position, int flags) {
+    CallRecord record;
+
+    memset(&record, 0, sizeof(record));
+    record.startMs = startMs;
+    record.durationMs = (int)(endMs - startMs);
+    record.clientID = clientID;
+    record.key = key;
+    record.ret = ret;
+    if (has_position(call)) {
+        record.value.position = position;
+    } else {
+        record.value.integer = integer;
+    }
+    record.call = (unsigned char)call;
+    record.flags = (unsigned char)flags;
+
+    pthread_mutex_lock(&recordLock);
+    if (callRecording != NULL && fwrite(&record, sizeof(record), 1, callRecording) != 1) {
+        printf("ERROR: Could not write to the call log, recording stops\n");
+        fclose(callRecording);
+        callRecording = NULL;
+    }
+    pthread_mutex_unlock(&recordLock);
+}
+
+/**
+ * Read the records of a log
+ * @param backend: Receives the backend it was recorded on (may be NULL)
+ * @return: Number of records (whole ones only), or -1 if the file is not a call log
+ */
+static long load(const char* path, CallRecord** loaded, char* backend) {
+    CallLogHeader header;
+    CallRecord* list = NULL;
+    long count = 0, capacity = 0;
+    FILE* file = fopen(path, "rb");
+
+    if (file == NULL) {
+        printf("ERROR: Could not open call log %s\n", path);
+        return -1;
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, CALL_LOG_MAGIC, 4) != 0
+        || header.version != CALL_LOG_VERSION || header.recordSize != (int)sizeof(CallRecord)) {
+        printf("ERROR: %s is not a call log\n", path);
+        fclose(file);
+        return -1;
+    }
+    for (;;) {
+        if (count == capacity) {
+            CallRecord* grown;
+            capacity = capacity ? capacity * 2 : 4096;
+            grown = (CallRecord*)realloc(list, capacity * sizeof(CallRecord));
+            if (grown == NULL) {
+                printf("ERROR: Out of memory reading %s\n", path);
+                free(list);
+                fclose(file);
+                return -1;
+            }
+            list = grown;
+        }
+        if (fread(&list[count], sizeof(CallRecord), 1, file) != 1) {
+            break;
+        }
+        if (list[count].call < LOG_CALL_COUNT) {
+            count++;
+        }
+    }
+    fclose(file);
+
+    if (backend != NULL) {
+        memcpy(backend, header.backend, sizeof(header.backend));
+        backend[sizeof(header.backend) - 1] = '\0';
+    }
+    *loaded = list;
+    return count;
+}
+
+/**
+ * Calls answered from the same records (a query and a buffered read both tell a position)
+ */
+static int lookup_group(int call) {
+    return call == LOG_QUERY_POSITION ? LOG_READ_POSITION : call;
+}
+
+/**
+ * Order of records by group, client, key and time; negative, 0 or positive like strcmp
+ */
+static int compare_lookup(int group, int clientID, int key, long long startMs, const CallRecord* record) {
+    int other = lookup_group(record->call);
+
+    if (group != other) {
+        return group < other ? -1 : 1;
+    }
+    if (clientID != record->clientID) {
+        return clientID < record->clientID ? -1 : 1;
+    }
+    if (key != record->key) {
+        return key < record->key ? -1 : 1;
+    }
+    if (startMs != record->startMs) {
+        return startMs < record->startMs ? -1 : 1;
+    }
+    return 0;
+}
+
+static int compare_order(const void* a, const void* b) {
+    const CallRecord* first = &records[*(const long*)a];
+    int diff = compare_lookup(lookup_group(first->call), first->clientID, first->key, first->startMs,
+                              &records[*(const long*)b]);
+
+    // Records of the same time keep the order they were made in
+    if (diff == 0) {
+        return *(const long*)a < *(const long*)b ? -1 : *(const long*)a > *(const long*)b;
+    }
+    return diff;
+}
+
+/**
+ * First position in order[] whose record is not before (group, client, key, startMs)
+ */
+static long lower_bound(int group, int clientID, int key, long long startMs) {
+    long lo = 0, hi = recordCount;
+
+    while (lo < hi) {
+        long mid = (lo + hi) / 2;
+        if (compare_lookup(group, clientID, key, startMs, &records[order[mid]]) > 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * Latest record of a call on one client and object made by the replay
+ * time (or the first one, if the replay is earlier than all of them)
+ * @return: The record, or NULL if that call was never made on the object
+ */
+static const CallRecord* find(int call, int clientID, int key) {
+    int group = lookup_group(call);
+    long long now = replayClock < 0 ? 0 : replayClock;
+    long first = lower_bound(group, clientID, key, LLONG_MIN);
+    long after = lower_bound(group, clientID, key, now + 1);
+
+    if (after > first) {
+        return &records[order[after - 1]];
+    }
+    if (first < recordCount && lookup_group(records[order[first]].call) == group
+        && records[order[first]].clientID == clientID && records[order[first]].key == key) {
+        return &records[order[first]];
+    }
+    return NULL;
+}
+
+/**
+ * Let replay time pass (and wall time too when replaying at the recorded pace)
+ */
+static void take(long long ms) {
+    if (ms <= 0) {
+        return;
+    }
+    replayClock += ms;
+    if (replaySpeed == REPLAY_RECORDED) {
+        usleep((useconds_t)(ms * 1000));
+    }
+}
+
+int call_log_replay(const char* path, int speed) {
+    char backend[20];
+    long i;
+
+    recordCount = load(path, &records, backend);
+    if (recordCount < 0) {
+        recordCount = 0;
+        return -1;
+    }
+    order = (long*)malloc((recordCount ? recordCount : 1) * sizeof(long));
+    if (order == NULL) {
+        printf("ERROR: Out of memory indexing %s\n", path);
+        return -1;
+    }
+    for (i = 0; i < recordCount; i++) {
+        order[i] = i;
+    }
+    qsort(order, recordCount, sizeof(long), compare_order);
+    replaySpeed = speed;
+    printf("Replaying %ld call(s) recorded on the '%s' backend (%s)\n", recordCount, backend,
+           speed == REPLAY_RECORDED ? "recorded pace" : "as fast as possible");
+    return 0;
+}
+
+int replay_connect(int port) {
+    const CallRecord* record = NULL;
+    long first, last;
+    int i;
+
+    if (records == NULL) {
+        printf("ERROR: No call log to replay (--replay <file>)\n");
+        return -1;
+    }
+    pthread_mutex_lock(&replayLock);
+    for (i = 0; i < cursorCount && cursorPorts[i] != port; i++) {
+    }
+    if (i == cursorCount && cursorCount < REPLAY_MAX_PORTS) {
+        cursorPorts[cursorCount] = port;
+        cursorUsed[cursorCount++] = 0;
+    }
+
+    // Connections to a port are handed out in the order they were made
+    first = lower_bound(LOG_CONNECT, -1, port, LLONG_MIN);
+    last = lower_bound(LOG_CONNECT, -1, port + 1, LLONG_MIN);
+    if (i < cursorCount && first + cursorUsed[i] < last) {
+        record = &records[order[first + cursorUsed[i]++]];
+    }
+    pthread_mutex_unlock(&replayLock);
+
+    if (record == NULL) {
+        printf("ERROR: The call log has no more connections to port %d\n", port);
+        return -1;
+    }
+    if (replayClock < 0) {
+        replayClock = record->startMs;
+    }
+    take(record->durationMs);
+    return record->ret;
+}
+
+void replay_disconnect(int clientID) {
+    (void)clientID;
+}
+
+int replay_connection_id(int clientID) {
+    const CallRecord* record = find(LOG_CONNECTION_ID, clientID, 0);
+
+    // A client that never asked was connected all along
+    return record != NULL ? record->ret : clientID;
+}
+
+int replay_get_handle(int clientID, const char* name, int* handle) {
+    const CallRecord* record = find(LOG_GET_HANDLE, clientID, call_log_name_key(name));
+
+    *handle = -1;
+    if (record == NULL) {
+        return simx_return_remote_error_flag;
+    }
+    take(record->durationMs);
+    *handle = record->value.integer;
+    return record->ret;
+}
+
+int replay_set_target(int clientID, int handle, int wait) {
+    const CallRecord* record = find(LOG_SET_TARGET, clientID, handle);
+
+    if (record == NULL) {
+        return wait ? simx_return_ok : simx_return_novalue_flag;
+    }
+    if (wait) {
+        take(record->durationMs);
+    }
+    return record->ret;
+}
+
+int replay_stream(int clientID, int call, int key) {
+    const CallRecord* record = find(call, clientID, key);
+
+    return record != NULL ? record->ret : simx_return_novalue_flag;
+}
+
+int replay_read_position(int clientID, int handle, float* position, int query) {
+    const CallRecord* record = find(LOG_READ_POSITION, clientID, handle);
+
+    *position = 0;
+    if (record == NULL) {
+        return query ? simx_return_remote_error_flag : simx_return_novalue_flag;
+    }
+    if (query) {
+        take(record->call == LOG_QUERY_POSITION ? record->durationMs : 0);
+    }
+    *position = record->value.position;
+    return record->ret;
+}
+
+int replay_read_signal(int clientID, const char* name, int* value) {
+    const CallRecord* record = find(LOG_READ_SIGNAL, clientID, call_log_name_key(name));
+
+    *value = 0;
+    if (record == NULL) {
+        return simx_return_novalue_flag;
+    }
+    *value = record->value.integer;
+    return record->ret;
+}
+
+int replay_call(int clientID, int call, int key) {
+    const CallRecord* record = find(call, clientID, key);
+
+    if (record == NULL) {
+        return simx_return_ok;
+    }
+    take(record->durationMs);
+    return record->ret;
+}
+
+long long replay_now_ms(void) {
+    if (replayClock < 0) {
+        return recordCount > 0 ? records[0].startMs : 0;
+    }
+    return replayClock;
+}
+
+void replay_sleep_ms(int ms) {
+    if (replayClock < 0) {
+        replayClock = replay_now_ms();
+    }
+    take(ms);
+}
+
+long call_log_summary(const char* path, FILE* out, FILE* csv) {
+    CallRecord* list = NULL;
+    char backend[20];
+    long count[LOG_CALL_COUNT] = {0};
+    long long total[LOG_CALL_COUNT] = {0}, longest[LOG_CALL_COUNT] = {0};
+    long long firstMs = 0, lastMs = 0;
+    long n = load(path, &list, backend), i;
+
+    if (n < 0) {
+        return -1;
+    }
+    if (csv != NULL) {
+        fprintf(csv, "call,start_ms,duration_ms,client,key,ret,value\n");
+    }
+    for (i = 0; i < n; i++) {
+        const CallRecord* record = &list[i];
+
+        count[record->call]++;
+        total[record->call] += record->durationMs;
+        if (record->durationMs > longest[record->call]) {
+            longest[record->call] = record->durationMs;
+        }
+        if (i == 0 || record->startMs < firstMs) {
+            firstMs = record->startMs;
+        }
+        if (i == 0 || record->startMs + record->durationMs > lastMs) {
+            lastMs = record->startMs + record->durationMs;
+        }
+        if (csv != NULL) {
+            fprintf(csv, "%s,%lld,%d,%d,%d,%d,", CALL_NAMES[record->call], record->startMs, record->durationMs,
+                    record->clientID, record->key, record->ret);
+            if (has_position(record->call)) {
+                fprintf(csv, "%.6f\n", record->value.position);
+            } else {
+                fprintf(csv, "%d\n", record->value.integer);
+            }
+        }
+    }
+
+    fprintf(out, "%ld call(s) recorded on the '%s' backend over %lld ms\n", n, backend, lastMs - firstMs);
+    fprintf(out, "%-16s %10s %12s %10s %10s\n", "Call", "count", "total ms", "mean ms", "max ms");
+    for (i = 0; i < LOG_CALL_COUNT; i++) {
+        if (count[i] > 0) {
+            fprintf(out, "%-16s %10ld %12lld %10.2f %10lld\n", CALL_NAMES[i], count[i], total[i],
+                    (double)total[i] / count[i], longest[i]);
+        }
+    }
+    free(list);
+    return n;
+}
@@ -0,0 +1,132 @@
+/*
+ * Remote Call Log
+ *
+ * Binary record of a session with the simulator: every call made through
+ * transport.h, with its client, argument, return code, the value it sent
+ * or got back, and when it started and how long it took on the link's
+ * clock. --record writes one while the controller runs against any
+ * backend; a build with the replay backend (TRANSPORT_REPLAY) answers its
+ * calls from one with --replay, without CoppeliaSim.
+ *
+ * Records are fixed-size and appended through a stdio buffer, so a log cut
+ * short by a crash is still readable up to its last whole record.
+ *
+ * Replay does not require the same call sequence, so a newer controller
+ * can run on the trace of an older one. Each call is answered with the
+ * latest recorded call of the same kind, client and object (handle, signal
+ * or port) at the replay time. Blocking calls take as long as they took
+ * when recorded, and sleeps advance the time, either instantly or at the
+ * recorded pace. call_log_dump prints the call counts and times of a log,
+ * so two runs on one trace can be compared.
+ */
+
+#ifndef CALL_LOG_H
+#define CALL_LOG_H
+
+#include <stdio.h>
+
+// File signature and format version of call logs
+#define CALL_LOG_MAGIC "NRC1"
+#define CALL_LOG_VERSION 1
+
+// Calls of the transport, as stored in the log
+enum LoggedCall {
+    LOG_CONNECT = 0,          // key: port, ret: client id
+    LOG_DISCONNECT = 1,
+    LOG_CONNECTION_ID = 2,    // ret: connection id (-1 once the link is lost)
+    LOG_GET_HANDLE = 3,       // key: name hash, value: handle
+    LOG_SET_TARGET = 4,       // key: handle, value: target, flags: LOG_WAITED
+    LOG_STREAM_POSITION = 5,  // key: handle
+    LOG_READ_POSITION = 6,    // key: handle, value: position
+    LOG_QUERY_POSITION = 7,   // key: handle, value: position (round trip)
+    LOG_STREAM_SIGNAL = 8,    // key: name hash
+    LOG_READ_SIGNAL = 9,      // key: name hash, value: signal
+    LOG_PAUSE = 10,           // key: 1 to pause, 0 to send
+    LOG_PING = 11,
+    LOG_SYNCHRONOUS = 12,     // key: 1 to enable
+    LOG_TRIGGER = 13,
+    LOG_SLEEP = 14,           // key: milliseconds
+    LOG_CALL_COUNT = 15
+};
+
+// Record flags
+#define LOG_WAITED 1          // The call waited for its reply
+
+// Pace of a replay
+enum ReplaySpeed {
+    REPLAY_FAST = 0,          // Sleeps and round trips only advance the replay clock
+    REPLAY_RECORDED = 1       // They also take their time on the wall clock
+};
+
+// Start of the file (the records follow)
+typedef struct {
+    char magic[4];            // CALL_LOG_MAGIC
+    int version;              // CALL_LOG_VERSION
+    int recordSize;           // sizeof(CallRecord)
+    char backend[20];         // Transport the log was recorded on (transport.h)
+} CallLogHeader;
+
+// One call
+typedef struct {
+    long long startMs;        // Link clock when the call was made
+    int durationMs;           // Link time it took
+    int clientID;             // Client it was made on (-1: none, e.g. a connect or a sleep)
+    int key;                  // Object or argument, see LoggedCall
+    int ret;                  // Return code (client or connection id where noted)
+    union {
+        float position;
+        int integer;
+    } value;                  // Value sent or received, see LoggedCall
+    unsigned char call;       // LoggedCall
+    unsigned char flags;      // LOG_WAITED
+    unsigned char reserved[2];
+} CallRecord;
+
+// Open log being written (NULL when not recording)
+extern FILE* callRecording;
+
+/**
+ * Hash of a handle or signal name, used as the key of named calls
+ */
+int call_log_name_key(const char* name);
+
+/**
+ * Start recording every call of the transport to a new file (closed at exit)
+ * @param backend: Name of the transport the calls go to
+ * @return: 0 on success, -1 if the file cannot be written (reported with printf)
+ */
+int call_log_record(const char* path, const char* backend);
+
+/**
+ * Append one call to the log being recorded. Safe to call from several threads.
+ */
+void call_log_write(int call, long long startMs, long long endMs, int clientID, int key, int ret,
+                    int integer, float position, int flags);
+
+/**
+ * Load a log for the replay backend
+ * @return: 0 on success, -1 if the file is not a call log (reported with printf)
+ */
+int call_log_replay(const char* path, int speed);
+
+/**
+ * Print the number of calls of each kind with their total, mean and
+ * longest time, and write every record as CSV to csv if it is not NULL
+ * @return: Records in the log, or -1 if it cannot be read
+ */
+long call_log_summary(const char* path, FILE* out, FILE* csv);
+
+// Replay backend (transport.h, TRANSPORT_REPLAY): each answers from the loaded log
+int replay_connect(int port);
+void replay_disconnect(int clientID);
+int replay_connection_id(int clientID);
+int replay_get_handle(int clientID, const char* name, int* handle);
+int replay_set_target(int clientID, int handle, int wait);
+int replay_stream(int clientID, int call, int key);
+int replay_read_position(int clientID, int handle, float* position, int query);
+int replay_read_signal(int clientID, const char* name, int* value);
+int replay_call(int clientID, int call, int key);
+long long replay_now_ms(void);
+void replay_sleep_ms(int ms);
+
+#endif
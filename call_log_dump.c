@@ -0,0 +1,41 @@
+/*
+ * Call Log Dump
+ *
+ * Prints how many remote calls of each kind a log recorded with --record
+ * holds, with their total, mean and longest time, so two runs (e.g. two
+ * controller versions replaying the same log) can be compared. With a
+ * second argument every call is also written as CSV: call, start_ms,
+ * duration_ms, client, key, ret, value.
+ *
+ * Usage: call_log_dump <call log> [csv file]
+ */
+
+#include <stdio.h>
+
+#include "call_log.h"
+
+int main(int argc, char* argv[]) {
+    FILE* csv = NULL;
+    long records;
+
+    if (argc < 2 || argc > 3) {
+        printf("Usage: %s <call log> [csv file]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 3) {
+        csv = fopen(argv[2], "w");
+        if (csv == NULL) {
+            printf("ERROR: Could not write %s\n", argv[2]);
+            return 1;
+        }
+    }
+
+    records = call_log_summary(argv[1], stdout, csv);
+    if (csv != NULL) {
+        fclose(csv);
+        if (records >= 0) {
+            printf("SUCCESS: %ld call(s) written to %s\n", records, argv[2]);
+        }
+    }
+    return records >= 0 ? 0 : 1;
+}
@@ -0,0 +1,734 @@
+/*
+ * In-Process Stand-In for the CoppeliaSim Legacy Remote API
+ *
+ * Scene model: up to SIM_MAX_ARMS keypad arms (/base_link_respondable[n]/joint_1..3)
+ * and the six joint /NiryoOne/Joint chain. Joint objects are created the
+ * first time their name is looked up. Each joint moves towards its target
+ * as a first-order system:
+ *
+ *     position(t + dt) = target + (position(t) - target) * exp(-dt / tau)
+ *
+ * Every connection has its own clock, which only advances in extApi_sleepMs
+ * (charged to the last connection used by the calling thread) and in
+ * blocking calls (one simulated round trip each), so runs are deterministic
+ * and as fast as the CPU allows. Joints catch up with the clock of the
+ * connection that touches them, so arms driven from parallel threads each
+ * keep their own timeline. While a client holds the scene in synchronous
+ * mode, only simxSynchronousTrigger advances it, by one step per call.
+ *
+ * All state is behind one mutex, so the API can be called from several
+ * threads like the real library. A thread sleeping past the clock of
+ * another open connection waits for it to catch up, so parallel arms share
+ * work (e.g. a ballot queue) in simulated-time order rather than in the
+ * order the CPU happens to run them.
+ *
+ * Keypads: each arm has a keypad whose keys are where the built-in key
+ * layouts put them (key_layout.c). A key registers when every joint of the
+ * arm comes within SIM_CONTACT_RAD of the key's press pose, and can register
+ * again once the arm moved SIM_RELEASE_RAD away. The presses are published
+ * as the integer signal keypadPress[n] (chainPress for the chain scene):
+ * presses * 16 + last key. Contact is checked whenever the signal is read.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extApi.h"
+#include "extApiSim.h"
+#include "../key_layout.h"
+
+#define SIM_MAX_JOINTS 64
+#define SIM_MAX_CLIENTS 32
+#define SIM_MAX_ARMS 8
+#define SIM_CHAIN_JOINTS 6
+#define SIM_HANDLE_BASE 100
+
+// Joint distance (radians, every joint) at which a key makes contact, and at which it is released
+#define SIM_CONTACT_RAD 0.012
+#define SIM_RELEASE_RAD 0.018
+
+// One joint object of the scene
+typedef struct {
+    char name[150];
+    double position;
+    double target;
+    long long updatedAt;       // Simulated time the position was computed for
+    unsigned int streamedBy;   // Bit per client that subscribed to the position
+} SimJoint;
+
+// One remote API connection
+typedef struct {
+    int open;
+    int lost;                  // Link dropped: calls fail until the slot is closed with simxFinish
+    int connectionID;
+    long long now;             // Simulated time of this connection
+    long long dropAt;          // Simulated time the link drops (with EXTAPI_SIM_DROP_EVERY_MS)
+    int setReplies[SIM_MAX_JOINTS + 1];   // Reply flags of the last oneshot target per joint (last slot: bad handles)
+} SimClient;
+
+// Keypad of one arm (the last one belongs to the chain scene)
+typedef struct {
+    int joints[MAX_JOINTS];    // Joint object of each joint of the arm
+    unsigned int found;        // Bit per joint that was looked up
+    int touching;              // Key in contact (-1: none)
+    int contacts;              // Contacts made, registered or not
+    int presses;               // Contacts registered
+    int lastKey;               // Key of the last registered press
+    unsigned int streamedBy;   // Bit per client that subscribed to the signal
+} SimKeypad;
+
+static SimJoint joints[SIM_MAX_JOINTS];
+static SimKeypad keypads[SIM_MAX_ARMS + 1];
+static KeySolutions keyPoses[2];     // Press poses of the keypad and chain layouts (solved on first use)
+static int keyPosesSolved = 0;
+static int jointCount = 0;
+static SimClient clients[SIM_MAX_CLIENTS];
+static int nextConnectionID = 1;
+static int configured = 0;
+
+static pthread_mutex_t simLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t clockMoved = PTHREAD_COND_INITIALIZER;
+static thread_local int threadClient = -1;   // Connection extApi_sleepMs charges on this thread
+static double tauMs = SIM_DEFAULT_TAU_MS;
+static int roundTripMs = SIM_DEFAULT_ROUND_TRIP_MS;
+static int stepMs = SIM_DEFAULT_STEP_MS;
+static int dropEveryMs = 0;
+static int missEvery = 0;
+static int synchronousClient = -1;
+static SimStats stats;
+
+/**
+ * Read the model settings from the environment once
+ */
+static void load_configuration() {
+    const char* value;
+
+    if (configured) {
+        return;
+    }
+    configured = 1;
+    if ((value = getenv("EXTAPI_SIM_TAU_MS")) != NULL && atoi(value) > 0) {
+        tauMs = atoi(value);
+    }
+    if ((value = getenv("EXTAPI_SIM_RTT_MS")) != NULL && atoi(value) >= 0) {
+        roundTripMs = atoi(value);
+    }
+    if ((value = getenv("EXTAPI_SIM_STEP_MS")) != NULL && atoi(value) > 0) {
+        stepMs = atoi(value);
+    }
+    if ((value = getenv("EXTAPI_SIM_DROP_EVERY_MS")) != NULL && atoi(value) > 0) {
+        dropEveryMs = atoi(value);
+    }
+    if ((value = getenv("EXTAPI_SIM_MISS_EVERY")) != NULL && atoi(value) > 0) {
+        missEvery = atoi(value);
+    }
+}
+
+/**
+ * Let a joint follow its target up to the given time
+ */
+static void catch_up(SimJoint* joint, long long now) {
+    if (now <= joint->updatedAt) {
+        return;
+    }
+    joint->position = joint->target + (joint->position - joint->target) * exp(-(double)(now - joint->updatedAt) / tauMs);
+    joint->updatedAt = now;
+}
+
+/**
+ * Move the clock of one connection forward
+ */
+static void advance(int clientID, long long ms) {
+    if (ms > 0 && clientID >= 0) {
+        clients[clientID].now += ms;
+        pthread_cond_broadcast(&clockMoved);
+    }
+}
+
+/**
+ * Check whether another open connection is still behind the given one
+ */
+static int others_behind(int clientID) {
+    int id;
+
+    for (id = 0; id < SIM_MAX_CLIENTS; id++) {
+        if (id != clientID && clients[id].open && clients[id].now < clients[clientID].now) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Find the keypad and joint number of a joint of the modelled scene
+ * @return: 1 if the name is a scene joint, 0 otherwise
+ */
+static int keypad_joint(const char* name, int* keypad, int* joint) {
+    int arm, length = 0;
+    const char* rest;
+
+    if (sscanf(name, "/base_link_respondable[%d]/joint_%d%n", &arm, joint, &length) == 2
+        && name[length] == '\0') {
+        *keypad = arm;
+        (*joint)--;
+        return arm >= 0 && arm < SIM_MAX_ARMS && *joint >= 0 && *joint < 3;
+    }
+
+    if (strncmp(name, "/NiryoOne/Joint", 15) == 0) {
+        rest = name + 15;
+        for (*joint = 0; *joint < SIM_CHAIN_JOINTS - 1 && strncmp(rest, "/Link/Joint", 11) == 0; (*joint)++) {
+            rest += 11;
+        }
+        *keypad = SIM_MAX_ARMS;
+        return *rest == '\0';
+    }
+    return 0;
+}
+
+/**
+ * Check that a name is a joint of the modelled scene
+ */
+static int is_scene_joint(const char* name) {
+    int keypad, joint;
+
+    return keypad_joint(name, &keypad, &joint);
+}
+
+/**
+ * Find the keypad a signal name belongs to
+ * @return: Keypad index, or -1 if the scene has no such signal
+ */
+static int keypad_signal(const char* name) {
+    int arm, length = 0;
+
+    if (strcmp(name, "chainPress") == 0) {
+        return SIM_MAX_ARMS;
+    }
+    if (sscanf(name, "keypadPress[%d]%n", &arm, &length) == 1 && name[length] == '\0' && arm >= 0 && arm < SIM_MAX_ARMS) {
+        return arm;
+    }
+    return -1;
+}
+
+/**
+ * Register a press when the arm of a keypad reaches a key, and release the
+ * key once it moved away. Must be called with simLock held.
+ */
+static void update_contact(int keypad, long long now) {
+    SimKeypad* pad = &keypads[keypad];
+    const KeySolutions* poses = &keyPoses[keypad == SIM_MAX_ARMS ? 1 : 0];
+    int count = keypad == SIM_MAX_ARMS ? SIM_CHAIN_JOINTS : 3;
+    double distance[KEY_COUNT];
+    int key, j, closest = -1;
+
+    if (!keyPosesSolved) {
+        float zero[MAX_JOINTS] = {0};
+        layout_solve(&KEYPAD_LAYOUT, &NIRYO_ONE_GEOMETRY, zero, &keyPoses[0]);
+        layout_solve(&CHAIN_LAYOUT, &NIRYO_ONE_GEOMETRY, zero, &keyPoses[1]);
+        keyPosesSolved = 1;
+    }
+    if (pad->found != (1u << count) - 1) {
+        return;
+    }
+    for (j = 0; j < count; j++) {
+        catch_up(&joints[pad->joints[j]], now);
+    }
+
+    for (key = 0; key < KEY_COUNT; key++) {
+        distance[key] = 0;
+        for (j = 0; j < count; j++) {
+            distance[key] = fmax(distance[key], fabs(joints[pad->joints[j]].position - poses->press[key][j]));
+        }
+        if (distance[key] <= SIM_CONTACT_RAD && (closest == -1 || distance[key] < distance[closest])) {
+            closest = key;
+        }
+    }
+
+    if (pad->touching != -1 && distance[pad->touching] > SIM_RELEASE_RAD) {
+        pad->touching = -1;
+    }
+    if (pad->touching == -1 && closest != -1) {
+        pad->touching = closest;
+        pad->contacts++;
+        // EXTAPI_SIM_MISS_EVERY: every n-th contact does not register
+        if (missEvery == 0 || pad->contacts % missEvery != 0) {
+            pad->presses++;
+            pad->lastKey = closest;
+        } else {
+            stats.missedPresses++;
+        }
+    }
+}
+
+/**
+ * Validate the client id and charge a round trip for blocking calls.
+ * Must be called with simLock held.
+ * @return: simx_return_ok or the error flag to return
+ */
+static int begin_call(simxInt clientID, simxInt operationMode) {
+    if (clientID < 0 || clientID >= SIM_MAX_CLIENTS || !clients[clientID].open) {
+        return simx_return_initialize_error_flag;
+    }
+    threadClient = clientID;
+
+    // A dropped link times out blocking calls and silently loses the others
+    if (!clients[clientID].lost && dropEveryMs > 0 && clients[clientID].now >= clients[clientID].dropAt) {
+        clients[clientID].lost = 1;
+        stats.linkDrops++;
+    }
+    if (clients[clientID].lost) {
+        if (operationMode == simx_opmode_blocking) {
+            advance(clientID, roundTripMs);
+            return simx_return_timeout_flag;
+        }
+        return operationMode == simx_opmode_buffer ? simx_return_ok : simx_return_novalue_flag;
+    }
+    if (operationMode == simx_opmode_blocking) {
+        stats.blockingCalls++;
+        if (synchronousClient == -1) {
+            advance(clientID, roundTripMs);
+        }
+    } else if (operationMode == simx_opmode_oneshot) {
+        stats.oneshotCalls++;
+    }
+    return simx_return_ok;
+}
+
+static SimJoint* find_joint(simxInt handle) {
+    int index = handle - SIM_HANDLE_BASE;
+
+    if (index < 0 || index >= jointCount) {
+        return NULL;
+    }
+    return &joints[index];
+}
+
+simxInt simxStart(const simxChar* connectionAddress, simxInt connectionPort, simxUChar waitUntilConnected,
+                  simxUChar doNotReconnectOnceDisconnected, simxInt timeOutInMs, simxInt commThreadCycleInMs) {
+    int id;
+
+    (void)waitUntilConnected;
+    (void)doNotReconnectOnceDisconnected;
+    (void)timeOutInMs;
+    (void)commThreadCycleInMs;
+
+    if (connectionAddress == NULL || connectionPort <= 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&simLock);
+    load_configuration();
+    for (id = 0; id < SIM_MAX_CLIENTS; id++) {
+        if (!clients[id].open) {
+            // A reused slot keeps its clock, so a reconnecting arm continues its timeline
+            clients[id].open = 1;
+            clients[id].lost = 0;
+            clients[id].dropAt = clients[id].now + dropEveryMs;
+            clients[id].connectionID = nextConnectionID++;
+            memset(clients[id].setReplies, 0, sizeof(clients[id].setReplies));
+            threadClient = id;
+            pthread_mutex_unlock(&simLock);
+            return id;
+        }
+    }
+    pthread_mutex_unlock(&simLock);
+    return -1;
+}
+
+simxVoid simxFinish(simxInt clientID) {
+    int id, j;
+
+    pthread_mutex_lock(&simLock);
+    for (id = 0; id < SIM_MAX_CLIENTS; id++) {
+        if (clientID != -1 && id != clientID) {
+            continue;
+        }
+        if (id == synchronousClient) {
+            synchronousClient = -1;
+        }
+        clients[id].open = 0;
+        for (j = 0; j < jointCount; j++) {
+            joints[j].streamedBy &= ~(1u << id);
+        }
+        for (j = 0; j <= SIM_MAX_ARMS; j++) {
+            keypads[j].streamedBy &= ~(1u << id);
+        }
+    }
+    pthread_cond_broadcast(&clockMoved);
+    pthread_mutex_unlock(&simLock);
+}
+
+simxInt simxGetConnectionId(simxInt clientID) {
+    int connectionID = -1;
+
+    pthread_mutex_lock(&simLock);
+    if (clientID >= 0 && clientID < SIM_MAX_CLIENTS && clients[clientID].open && !clients[clientID].lost) {
+        connectionID = clients[clientID].connectionID;
+    }
+    pthread_mutex_unlock(&simLock);
+    return connectionID;
+}
+
+simxInt simxPauseCommunication(simxInt clientID, simxUChar enable) {
+    int ret;
+
+    // No simulated time passes between the paused commands, so applying them
+    // as they arrive is the same as releasing them together on resume
+    (void)enable;
+    pthread_mutex_lock(&simLock);
+    ret = begin_call(clientID, simx_opmode_oneshot);
+    pthread_mutex_unlock(&simLock);
+    return ret;
+}
+
+simxInt simxGetPingTime(simxInt clientID, simxInt* pingTime) {
+    int ret;
+
+    pthread_mutex_lock(&simLock);
+    ret = begin_call(clientID, simx_opmode_blocking);
+    if (ret == simx_return_ok) {
+        *pingTime = roundTripMs;
+    }
+    pthread_mutex_unlock(&simLock);
+    return ret;
+}
+
+simxInt simxSynchronous(simxInt clientID, simxUChar enable) {
+    int ret;
+
+    pthread_mutex_lock(&simLock);
+    ret = begin_call(clientID, simx_opmode_blocking);
+    if (ret == simx_return_ok) {
+        if (enable) {
+            synchronousClient = clientID;
+        } else if (synchronousClient == clientID) {
+            synchronousClient = -1;
+        }
+    }
+    pthread_mutex_unlock(&simLock);
+    return ret;
+}
+
+simxInt simxSynchronousTrigger(simxInt clientID) {
+    int ret;
+
+    pthread_mutex_lock(&simLock);
+    ret = begin_call(clientID, simx_opmode_blocking);
+    if (ret == simx_return_ok) {
+        if (synchronousClient != clientID) {
+            ret = simx_return_remote_error_flag;
+        } else {
+            stats.steps++;
+            advance(clientID, stepMs);
+        }
+    }
+    pthread_mutex_unlock(&simLock);
+    return ret;
+}
+
+/**
+ * simxGetObjectHandle with simLock held
+ */
+static int get_object_handle(simxInt clientID, const simxChar* objectName, simxInt* handle, simxInt operationMode) {
+    int ret = begin_call(clientID, operationMode);
+    int j, keypad, number;
+
+    if (ret != simx_return_ok) {
+        return ret;
+    }
+    stats.handleLookups++;
+
+    for (j = 0; j < jointCount; j++) {
+        if (strcmp(joints[j].name, objectName) == 0) {
+            *handle = SIM_HANDLE_BASE + j;
+            return simx_return_ok;
+        }
+    }
+    if (!is_scene_joint(objectName) || jointCount == SIM_MAX_JOINTS || strlen(objectName) >= sizeof(joints[0].name)) {
+        return simx_return_remote_error_flag;
+    }
+
+    if (keypad_joint(objectName, &keypad, &number)) {
+        keypads[keypad].joints[number] = jointCount;
+        if (keypads[keypad].found == 0) {
+            keypads[keypad].touching = -1;
+        }
+        keypads[keypad].found |= 1u << number;
+    }
+    strcpy(joints[jointCount].name, objectName);
+    joints[jointCount].position = 0;
+    joints[jointCount].target = 0;
+    joints[jointCount].updatedAt = clients[clientID].now;
+    joints[jointCount].streamedBy = 0;
+    *handle = SIM_HANDLE_BASE + jointCount;
+    jointCount++;
+    return simx_return_ok;
+}
+
+simxInt simxGetObjectHandle(simxInt clientID, const simxChar* objectName, simxInt* handle, simxInt operationMode) {
+    int ret;
+
+    pthread_mutex_lock(&simLock);
+    ret = get_object_handle(clientID, objectName, handle, operationMode);
+    pthread_mutex_unlock(&simLock);
+    return ret;
+}
+
+/**
+ * simxSetJointTargetPosition with simLock held
+ */
+static int set_joint_target(simxInt clientID, simxInt jointHandle, simxFloat targetPosition, simxInt operationMode) {
+    int ret = begin_call(clientID, operationMode);
+    SimJoint* joint;
+    int* reply;
+
+    if (ret != simx_return_ok) {
+        return ret;
+    }
+    stats.targetCommands++;
+
+    joint = find_joint(jointHandle);
+    if (joint != NULL) {
+        catch_up(joint, clients[clientID].now);
+        joint->target = targetPosition;
+        ret = simx_return_ok;
+    } else {
+        ret = simx_return_remote_error_flag;
+    }
+    if (operationMode != simx_opmode_oneshot) {
+        return ret;
+    }
+
+    // Like the real library, a oneshot call returns the reply to the previous
+    // command of the same kind on that object, since its own is still on the way
+    reply = &clients[clientID].setReplies[joint != NULL ? joint - joints : SIM_MAX_JOINTS];
+    int previous = *reply;
+    *reply = ret;
+    return simx_return_novalue_flag | previous;
+}
+
+simxInt simxSetJointTargetPosition(simxInt clientID, simxInt jointHandle, simxFloat targetPosition, simxInt operationMode) {
+    int ret;
+
+    pthread_mutex_lock(&simLock);
+    ret = set_joint_target(clientID, jointHandle, targetPosition, operationMode);
+    pthread_mutex_unlock(&simLock);
+    return ret;
+}
+
+/**
+ * simxGetJointPosition with simLock held
+ */
+static int get_joint_position(simxInt clientID, simxInt jointHandle, simxFloat* position, simxInt operationMode) {
+    int ret = begin_call(clientID, operationMode);
+    unsigned int bit;
+    SimJoint* joint;
+
+    if (ret != simx_return_ok) {
+        return ret;
+    }
+    if ((joint = find_joint(jointHandle)) == NULL) {
+        return simx_return_remote_error_flag;
+    }
+    catch_up(joint, clients[clientID].now);
+    bit = 1u << clientID;
+
+    switch (operationMode) {
+        case simx_opmode_blocking:
+            *position = (simxFloat)joint->position;
+            return simx_return_ok;
+
+        case simx_opmode_streaming:
+            // The first streaming call only subscribes, later ones read the buffer
+            if (!(joint->streamedBy & bit)) {
+                joint->streamedBy |= bit;
+                return simx_return_novalue_flag;
+            }
+            stats.bufferReads++;
+            *position = (simxFloat)joint->position;
+            return simx_return_ok;
+
+        case simx_opmode_buffer:
+            if (!(joint->streamedBy & bit)) {
+                return simx_return_novalue_flag;
+            }
+            stats.bufferReads++;
+            *position = (simxFloat)joint->position;
+            return simx_return_ok;
+
+        case simx_opmode_discontinue:
+        case simx_opmode_remove:
+            joint->streamedBy &= ~bit;
+            return simx_return_ok;
+
+        default:
+            return simx_return_illegal_opmode_flag;
+    }
+}
+
+simxInt simxGetJointPosition(simxInt clientID, simxInt jointHandle, simxFloat* position, simxInt operationMode) {
+    int ret;
+
+    pthread_mutex_lock(&simLock);
+    ret = get_joint_position(clientID, jointHandle, position, operationMode);
+    pthread_mutex_unlock(&simLock);
+    return ret;
+}
+
+/**
+ * simxGetIntegerSignal with simLock held
+ */
+static int get_integer_signal(simxInt clientID, const simxChar* signalName, simxInt* signalValue, simxInt operationMode) {
+    int ret = begin_call(clientID, operationMode);
+    int keypad = keypad_signal(signalName);
+    unsigned int bit = 1u << clientID;
+    SimKeypad* pad;
+
+    if (ret != simx_return_ok) {
+        return ret;
+    }
+    if (keypad == -1) {
+        // Like the real scene, a signal nobody set has no value
+        return simx_return_novalue_flag;
+    }
+    pad = &keypads[keypad];
+    update_contact(keypad, clients[clientID].now);
+
+    switch (operationMode) {
+        case simx_opmode_blocking:
+            break;
+
+        case simx_opmode_streaming:
+            if (!(pad->streamedBy & bit)) {
+                pad->streamedBy |= bit;
+                return simx_return_novalue_flag;
+            }
+            stats.bufferReads++;
+            break;
+
+        case simx_opmode_buffer:
+            if (!(pad->streamedBy & bit)) {
+                return simx_return_novalue_flag;
+            }
+            stats.bufferReads++;
+            break;
+
+        case simx_opmode_discontinue:
+        case simx_opmode_remove:
+            pad->streamedBy &= ~bit;
+            return simx_return_ok;
+
+        default:
+            return simx_return_illegal_opmode_flag;
+    }
+    *signalValue = pad->presses * 16 + (pad->lastKey & 15);
+    return simx_return_ok;
+}
+
+simxInt simxGetIntegerSignal(simxInt clientID, const simxChar* signalName, simxInt* signalValue, simxInt operationMode) {
+    int ret;
+
+    pthread_mutex_lock(&simLock);
+    ret = get_integer_signal(clientID, signalName, signalValue, operationMode);
+    pthread_mutex_unlock(&simLock);
+    return ret;
+}
+
+simxVoid extApi_sleepMs(simxInt ms) {
+    pthread_mutex_lock(&simLock);
+    stats.sleepCalls++;
+    stats.sleepMs += ms;
+    // A synchronous scene waits for its trigger, not for the wall clock
+    if (synchronousClient == -1 && threadClient >= 0) {
+        advance(threadClient, ms);
+        while (clients[threadClient].open && others_behind(threadClient)) {
+            pthread_cond_wait(&clockMoved, &simLock);
+        }
+    }
+    pthread_mutex_unlock(&simLock);
+}
+
+simxInt extApi_getTimeInMs(void) {
+    return (simxInt)extApi_simClientTimeMs(threadClient);
+}
+
+simxInt extApi_getTimeDiffInMs(simxInt lastTime) {
+    return extApi_getTimeInMs() - lastTime;
+}
+
+void extApi_simConfigure(int newTauMs, int newRoundTripMs) {
+    pthread_mutex_lock(&simLock);
+    configured = 1;
+    if (newTauMs > 0) {
+        tauMs = newTauMs;
+    }
+    if (newRoundTripMs >= 0) {
+        roundTripMs = newRoundTripMs;
+    }
+    pthread_mutex_unlock(&simLock);
+}
+
+long long extApi_simTimeMs(void) {
+    long long latest = 0;
+    int id;
+
+    pthread_mutex_lock(&simLock);
+    for (id = 0; id < SIM_MAX_CLIENTS; id++) {
+        if (clients[id].now > latest) {
+            latest = clients[id].now;
+        }
+    }
+    pthread_mutex_unlock(&simLock);
+    return latest;
+}
+
+long long extApi_simClientTimeMs(int clientID) {
+    long long now = 0;
+
+    pthread_mutex_lock(&simLock);
+    if (clientID >= 0 && clientID < SIM_MAX_CLIENTS) {
+        now = clients[clientID].now;
+    }
+    pthread_mutex_unlock(&simLock);
+    return now;
+}
+
+SimStats extApi_simStats(void) {
+    SimStats copy;
+
+    pthread_mutex_lock(&simLock);
+    copy = stats;
+    pthread_mutex_unlock(&simLock);
+    return copy;
+}
+
+void extApi_simResetStats(void) {
+    pthread_mutex_lock(&simLock);
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&simLock);
+}
+
+void extApi_simReset(void) {
+    int id, j;
+
+    pthread_mutex_lock(&simLock);
+    for (j = 0; j < jointCount; j++) {
+        joints[j].position = 0;
+        joints[j].target = 0;
+        joints[j].updatedAt = 0;
+    }
+    for (id = 0; id < SIM_MAX_CLIENTS; id++) {
+        clients[id].now = 0;
+    }
+    for (j = 0; j <= SIM_MAX_ARMS; j++) {
+        keypads[j].touching = -1;
+        keypads[j].contacts = 0;
+        keypads[j].presses = 0;
+        keypads[j].lastKey = 0;
+    }
+    synchronousClient = -1;
+    pthread_mutex_unlock(&simLock);
+}
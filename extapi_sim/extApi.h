@@ -0,0 +1,82 @@
+/*
+ * In-Process Stand-In for the CoppeliaSim Legacy Remote API
+ *
+ * Drop-in replacement for extApi.h: building a controller with
+ * -Iextapi_sim and linking extapi_sim/extApi.c instead of the real remote
+ * API library runs it against a simulated Niryo One, without CoppeliaSim.
+ *
+ * Only the calls used by the voting controllers are provided. Joints follow
+ * a first-order model (see extApiSim.h) and time is simulated: extApi_sleepMs
+ * advances the clock instantly, so a full voting file runs in milliseconds.
+ */
+
+#ifndef EXTAPI_SIM_H
+#define EXTAPI_SIM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Types used by the remote API
+typedef char simxChar;
+typedef unsigned char simxUChar;
+typedef short simxShort;
+typedef unsigned short simxUShort;
+typedef int simxInt;
+typedef unsigned int simxUInt;
+typedef float simxFloat;
+typedef void simxVoid;
+
+// Operation modes (same values as the real remote API)
+#define simx_opmode_oneshot 0x000000
+#define simx_opmode_blocking 0x010000
+#define simx_opmode_oneshot_wait 0x010000
+#define simx_opmode_continuous 0x020000
+#define simx_opmode_streaming 0x020000
+#define simx_opmode_oneshot_split 0x030000
+#define simx_opmode_continuous_split 0x040000
+#define simx_opmode_streaming_split 0x040000
+#define simx_opmode_discontinue 0x050000
+#define simx_opmode_buffer 0x060000
+#define simx_opmode_remove 0x070000
+
+// Return code flags (same values as the real remote API)
+#define simx_return_ok 0x000000
+#define simx_return_novalue_flag 0x000001
+#define simx_return_timeout_flag 0x000002
+#define simx_return_illegal_opmode_flag 0x000004
+#define simx_return_remote_error_flag 0x000008
+#define simx_return_split_progress_flag 0x000010
+#define simx_return_local_error_flag 0x000020
+#define simx_return_initialize_error_flag 0x000040
+
+// Connection
+simxInt simxStart(const simxChar* connectionAddress, simxInt connectionPort, simxUChar waitUntilConnected,
+                  simxUChar doNotReconnectOnceDisconnected, simxInt timeOutInMs, simxInt commThreadCycleInMs);
+simxVoid simxFinish(simxInt clientID);
+simxInt simxGetConnectionId(simxInt clientID);
+simxInt simxPauseCommunication(simxInt clientID, simxUChar enable);
+simxInt simxGetPingTime(simxInt clientID, simxInt* pingTime);
+
+// Synchronous operation
+simxInt simxSynchronous(simxInt clientID, simxUChar enable);
+simxInt simxSynchronousTrigger(simxInt clientID);
+
+// Objects and joints
+simxInt simxGetObjectHandle(simxInt clientID, const simxChar* objectName, simxInt* handle, simxInt operationMode);
+simxInt simxSetJointTargetPosition(simxInt clientID, simxInt jointHandle, simxFloat targetPosition, simxInt operationMode);
+simxInt simxGetJointPosition(simxInt clientID, simxInt jointHandle, simxFloat* position, simxInt operationMode);
+
+// Signals
+simxInt simxGetIntegerSignal(simxInt clientID, const simxChar* signalName, simxInt* signalValue, simxInt operationMode);
+
+// Platform helpers (extApiPlatform.h in the real library)
+simxVoid extApi_sleepMs(simxInt ms);
+simxInt extApi_getTimeInMs(void);
+simxInt extApi_getTimeDiffInMs(simxInt lastTime);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * Controls and Counters of the In-Process Simulator
+ *
+ * Not part of the real remote API: only tools built against extapi_sim
+ * (tests of the pacing logic, benchmarks) include this header.
+ */
+
+#ifndef EXTAPI_SIM_CONTROL_H
+#define EXTAPI_SIM_CONTROL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default time constant of the first-order joint model (milliseconds)
+#define SIM_DEFAULT_TAU_MS 200
+
+// Default simulated duration of a blocking round trip (milliseconds)
+#define SIM_DEFAULT_ROUND_TRIP_MS 2
+
+// Default simulation step advanced by simxSynchronousTrigger (milliseconds)
+#define SIM_DEFAULT_STEP_MS 50
+
+// Calls made against the simulator since the last reset
+typedef struct {
+    long long blockingCalls;    // Calls that waited for a reply (simx_opmode_blocking)
+    long long oneshotCalls;     // Fire-and-forget calls (simx_opmode_oneshot)
+    long long bufferReads;      // Streaming/buffer reads served locally
+    long long handleLookups;    // simxGetObjectHandle calls
+    long long targetCommands;   // simxSetJointTargetPosition calls
+    long long sleepCalls;       // extApi_sleepMs calls
+    long long sleepMs;          // Total simulated time spent in extApi_sleepMs
+    long long steps;            // Simulation steps triggered in synchronous mode
+    long long linkDrops;        // Connections dropped by EXTAPI_SIM_DROP_EVERY_MS
+    long long missedPresses;    // Key contacts not registered because of EXTAPI_SIM_MISS_EVERY
+} SimStats;
+
+/**
+ * Set the joint time constant and the cost of a blocking round trip.
+ * Can also be set with the EXTAPI_SIM_TAU_MS and EXTAPI_SIM_RTT_MS
+ * environment variables before the first simxStart (EXTAPI_SIM_STEP_MS
+ * sets the synchronous step, EXTAPI_SIM_DROP_EVERY_MS drops every
+ * connection after that much of its simulated time, to test reconnects,
+ * and EXTAPI_SIM_MISS_EVERY=n loses every n-th key contact of a keypad,
+ * to test press detection).
+ */
+void extApi_simConfigure(int tauMs, int roundTripMs);
+
+/**
+ * Current simulated time in milliseconds (64-bit, never wraps): the latest
+ * clock of all connections, i.e. the makespan when several arms run in parallel
+ */
+long long extApi_simTimeMs(void);
+
+/**
+ * Simulated time of one connection in milliseconds
+ */
+long long extApi_simClientTimeMs(int clientID);
+
+/**
+ * Counters since the last extApi_simResetStats()
+ */
+SimStats extApi_simStats(void);
+void extApi_simResetStats(void);
+
+/**
+ * Put every joint back at zero and restart the clock of every connection
+ */
+void extApi_simReset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * Fixed-Bucket Latency Histograms
+ */
+
+#include <stdio.h>
+
+#include "histogram.h"
+
+/**
+ * Bucket of a value: v itself below 4, then 4 * (msb - 1) plus the two bits after the msb
+ */
+static int bucket_of(long long ms) {
+    int msb = 2, index;
+
+    if (ms < 4) {
+        return (int)ms;
+    }
+    while ((ms >> (msb + 1)) != 0) {
+        msb++;
+    }
+    index = 4 * (msb - 1) + (int)((ms >> (msb - 2)) & 3);
+    return index < HIST_BUCKETS ? index : HIST_BUCKETS - 1;
+}
+
+/**
+ * Largest value that falls into a bucket
+ */
+static long long bucket_upper(int index) {
+    int msb = index / 4 + 1;
+
+    if (index < 4) {
+        return index;
+    }
+    return ((long long)(4 + index % 4 + 1) << (msb - 2)) - 1;
+}
+
+void hist_record(Histogram* histogram, long long ms) {
+    if (ms < 0) {
+        ms = 0;
+    }
+    if (histogram->count == 0 || ms < histogram->minMs) {
+        histogram->minMs = ms;
+    }
+    if (ms > histogram->maxMs) {
+        histogram->maxMs = ms;
+    }
+    histogram->count++;
+    histogram->sumMs += ms;
+    histogram->buckets[bucket_of(ms)]++;
+}
+
+void hist_merge(Histogram* into, const Histogram* from) {
+    int i;
+
+    if (from->count == 0) {
+        return;
+    }
+    if (into->count == 0 || from->minMs < into->minMs) {
+        into->minMs = from->minMs;
+    }
+    if (from->maxMs > into->maxMs) {
+        into->maxMs = from->maxMs;
+    }
+    into->count += from->count;
+    into->sumMs += from->sumMs;
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        into->buckets[i] += from->buckets[i];
+    }
+}
+
+long long hist_percentile(const Histogram* histogram, double fraction) {
+    long rank = (long)(fraction * histogram->count + 0.999999), seen = 0;
+    int i;
+
+    if (histogram->count == 0) {
+        return 0;
+    }
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (i = 0; i < HIST_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            return bucket_upper(i) < histogram->maxMs ? bucket_upper(i) : histogram->maxMs;
+        }
+    }
+    return histogram->maxMs;
+}
+
+void hist_print_header(const char* title) {
+    printf("%-18s %8s %9s %8s %8s %8s %8s %8s\n", title, "count", "mean", "min", "p50", "p90", "p99", "max");
+}
+
+void hist_print(const char* name, const Histogram* histogram) {
+    if (histogram->count == 0) {
+        return;
+    }
+    printf("%-18s %8ld %9.1f %8lld %8lld %8lld %8lld %8lld\n", name, histogram->count,
+           (double)histogram->sumMs / histogram->count, histogram->minMs,
+           hist_percentile(histogram, 0.50), hist_percentile(histogram, 0.90),
+           hist_percentile(histogram, 0.99), histogram->maxMs);
+}
@@ -0,0 +1,51 @@
+/*
+ * Fixed-Bucket Latency Histograms
+ *
+ * Buckets are exact below 4 ms, then four per power of two (each at most
+ * 25% wide) up to about 17 minutes; longer values go to the last bucket.
+ * Recording is a handful of integer operations on a fixed array, so it can
+ * sit around every move and remote call without allocating. A zeroed
+ * Histogram is empty.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#define HIST_BUCKETS 76
+
+typedef struct {
+    long count;
+    long long sumMs;
+    long long minMs;
+    long long maxMs;
+    long buckets[HIST_BUCKETS];
+} Histogram;
+
+/**
+ * Add one measurement (negative values count as 0)
+ */
+void hist_record(Histogram* histogram, long long ms);
+
+/**
+ * Add every measurement of another histogram
+ */
+void hist_merge(Histogram* into, const Histogram* from);
+
+/**
+ * Value below which a fraction of the measurements fall, to bucket precision
+ * @param fraction: 0.5 for the median, 0.99 for p99, ...
+ * @return: Upper bound of the bucket holding that rank (at most the maximum), 0 if empty
+ */
+long long hist_percentile(const Histogram* histogram, double fraction);
+
+/**
+ * Print the column titles used by hist_print()
+ */
+void hist_print_header(const char* title);
+
+/**
+ * Print one row: count, mean, min, p50, p90, p99 and max (nothing if empty)
+ */
+void hist_print(const char* name, const Histogram* histogram);
+
+#endif
@@ -0,0 +1,223 @@
+/*
+ * Joint Trace Recorder
+ *
+ * POSIX implementation: the file grows one block at a time with ftruncate()
+ * and only the block being filled is mapped (MAP_SHARED, written back by the
+ * kernel). The reader maps the whole file read-only.
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "joint_trace.h"
+
+// Columns of a block, as byte offsets from its start (rows count first)
+#define ROWS_OFFSET 0
+#define TIME_OFFSET 8
+#define BALLOT_OFFSET (TIME_OFFSET + TRACE_BLOCK_ROWS * 8)
+#define KEY_OFFSET (BALLOT_OFFSET + TRACE_BLOCK_ROWS * 4)
+#define COMMANDED_OFFSET (KEY_OFFSET + TRACE_BLOCK_ROWS)
+
+/**
+ * Offset of the commanded (kind 0) or actual (kind 1) column of a joint
+ */
+static size_t joint_column(int jointCount, int kind, int joint) {
+    return COMMANDED_OFFSET + ((size_t)kind * jointCount + joint) * TRACE_BLOCK_ROWS * sizeof(float);
+}
+
+/**
+ * Bytes of one block rounded up to whole pages
+ */
+static long long block_size(int jointCount) {
+    long long pageSize = sysconf(_SC_PAGESIZE);
+    long long size = (long long)joint_column(jointCount, 2, 0);
+
+    return (size + pageSize - 1) / pageSize * pageSize;
+}
+
+/**
+ * Grow the file by one block and map it in place of the full one
+ * @return: 0 on success, -1 on failure
+ */
+static int next_block(JointTrace* trace) {
+    long long offset = trace->dataOffset + trace->blocks * trace->blockSize;
+    void* block;
+
+    if (trace->block != NULL) {
+        munmap(trace->block, trace->blockSize);
+        trace->block = NULL;
+    }
+    if (ftruncate(trace->fd, (off_t)(offset + trace->blockSize)) == -1) {
+        printf("ERROR: Could not grow trace file to %lld bytes\n", offset + trace->blockSize);
+        return -1;
+    }
+    block = mmap(NULL, trace->blockSize, PROT_READ | PROT_WRITE, MAP_SHARED, trace->fd, (off_t)offset);
+    if (block == MAP_FAILED) {
+        printf("ERROR: Could not map trace file at offset %lld\n", offset);
+        return -1;
+    }
+    trace->block = (unsigned char*)block;
+    trace->blocks++;
+    return 0;
+}
+
+void trace_init(JointTrace* trace) {
+    trace->fd = -1;
+    trace->jointCount = 0;
+    trace->blockSize = 0;
+    trace->dataOffset = 0;
+    trace->blocks = 0;
+    trace->block = NULL;
+    trace->samples = 0;
+}
+
+int trace_open(JointTrace* trace, const char* path, int jointCount) {
+    TraceHeader header;
+
+    trace_init(trace);
+    if (jointCount < 1 || jointCount > TRACE_MAX_JOINTS) {
+        return -1;
+    }
+    trace->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (trace->fd == -1) {
+        printf("ERROR: Could not create trace file %s\n", path);
+        return -1;
+    }
+    trace->jointCount = jointCount;
+    trace->blockSize = block_size(jointCount);
+    trace->dataOffset = sysconf(_SC_PAGESIZE);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, 4);
+    header.version = TRACE_VERSION;
+    header.jointCount = jointCount;
+    header.blockRows = TRACE_BLOCK_ROWS;
+    header.blockSize = trace->blockSize;
+    header.dataOffset = trace->dataOffset;
+    if (pwrite(trace->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+        printf("ERROR: Could not write trace file %s\n", path);
+        trace_close(trace);
+        return -1;
+    }
+    return 0;
+}
+
+int trace_record(JointTrace* trace, long long timeMs, int ballot, int key, const float* commanded, const float* actual) {
+    int row, j;
+    int* rows;
+
+    if (trace->fd == -1) {
+        return -1;
+    }
+    if (trace->samples % TRACE_BLOCK_ROWS == 0 && next_block(trace) == -1) {
+        trace_close(trace);
+        return -1;
+    }
+
+    row = (int)(trace->samples % TRACE_BLOCK_ROWS);
+    ((long long*)(trace->block + TIME_OFFSET))[row] = timeMs;
+    ((int*)(trace->block + BALLOT_OFFSET))[row] = ballot;
+    ((signed char*)(trace->block + KEY_OFFSET))[row] = (signed char)key;
+    for (j = 0; j < trace->jointCount; j++) {
+        ((float*)(trace->block + joint_column(trace->jointCount, 0, j)))[row] = commanded[j];
+        ((float*)(trace->block + joint_column(trace->jointCount, 1, j)))[row] = actual[j];
+    }
+
+    // The row count is updated last, so a reader never sees a half-written sample
+    rows = (int*)(trace->block + ROWS_OFFSET);
+    *rows = row + 1;
+    trace->samples++;
+    return 0;
+}
+
+void trace_close(JointTrace* trace) {
+    if (trace->block != NULL) {
+        munmap(trace->block, trace->blockSize);
+        trace->block = NULL;
+    }
+    if (trace->fd != -1) {
+        close(trace->fd);
+        trace->fd = -1;
+    }
+}
+
+/**
+ * Print a position, or nothing when it is unknown
+ */
+static void print_position(FILE* out, float position) {
+    if (isnan(position)) {
+        fputc(',', out);
+    } else {
+        fprintf(out, ",%.5f", position);
+    }
+}
+
+long trace_dump_csv(const char* path, FILE* out) {
+    const TraceHeader* header;
+    const unsigned char* data;
+    const unsigned char* block;
+    struct stat info;
+    long long offset;
+    long samples = 0;
+    int fd, row, rows, j, kind;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &info) == -1 || info.st_size < (off_t)sizeof(TraceHeader)) {
+        printf("ERROR: Could not read trace file %s\n", path);
+        if (fd != -1) {
+            close(fd);
+        }
+        return -1;
+    }
+    data = (const unsigned char*)mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("ERROR: Could not map trace file %s\n", path);
+        return -1;
+    }
+
+    header = (const TraceHeader*)data;
+    if (memcmp(header->magic, TRACE_MAGIC, 4) != 0 || header->version != TRACE_VERSION
+        || header->jointCount < 1 || header->jointCount > TRACE_MAX_JOINTS
+        || header->blockRows != TRACE_BLOCK_ROWS || header->blockSize != block_size(header->jointCount)) {
+        printf("ERROR: %s is not a joint trace of this version\n", path);
+        munmap((void*)data, info.st_size);
+        return -1;
+    }
+
+    fprintf(out, "time_ms,ballot,key");
+    for (kind = 0; kind < 2; kind++) {
+        for (j = 0; j < header->jointCount; j++) {
+            fprintf(out, ",%s_j%d", kind == 0 ? "cmd" : "act", j + 1);
+        }
+    }
+    fputc('\n', out);
+
+    for (offset = header->dataOffset; offset + header->blockSize <= (long long)info.st_size; offset += header->blockSize) {
+        block = data + offset;
+        rows = *(const int*)(block + ROWS_OFFSET);
+        if (rows < 0 || rows > TRACE_BLOCK_ROWS) {
+            printf("ERROR: Corrupt trace block at offset %lld\n", offset);
+            break;
+        }
+        for (row = 0; row < rows; row++) {
+            fprintf(out, "%lld,%d,%d", ((const long long*)(block + TIME_OFFSET))[row],
+                    ((const int*)(block + BALLOT_OFFSET))[row], ((const signed char*)(block + KEY_OFFSET))[row]);
+            for (kind = 0; kind < 2; kind++) {
+                for (j = 0; j < header->jointCount; j++) {
+                    print_position(out, ((const float*)(block + joint_column(header->jointCount, kind, j)))[row]);
+                }
+            }
+            fputc('\n', out);
+            samples++;
+        }
+    }
+
+    munmap((void*)data, info.st_size);
+    return samples;
+}
@@ -0,0 +1,87 @@
+/*
+ * Joint Trace Recorder
+ *
+ * Append-only binary record of what the joints were asked to do and what
+ * they did: every sample holds a timestamp, the ballot and key being worked
+ * on, and the commanded and actual position of each joint. The file is
+ * written through memory-mapped blocks of TRACE_BLOCK_ROWS samples stored
+ * column by column (time, ballot, key, then one column per joint for the
+ * commanded and for the actual positions), so recording a sample is a few
+ * stores and a new block is mapped once every TRACE_BLOCK_ROWS samples.
+ *
+ * Each block keeps its number of rows, so a trace cut short by a crash is
+ * still readable up to the last sample written. trace_dump prints a trace
+ * as CSV.
+ */
+
+#ifndef JOINT_TRACE_H
+#define JOINT_TRACE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// File signature and format version of traces
+#define TRACE_MAGIC "NJT1"
+#define TRACE_VERSION 1
+
+// Samples per block
+#define TRACE_BLOCK_ROWS 4096
+
+// Most joints a trace can hold
+#define TRACE_MAX_JOINTS 6
+
+// Start of the file (the blocks follow at dataOffset)
+typedef struct {
+    char magic[4];          // TRACE_MAGIC
+    int version;            // TRACE_VERSION
+    int jointCount;         // Joint columns of each kind
+    int blockRows;          // Samples per block
+    long long blockSize;    // Bytes per block, page aligned
+    long long dataOffset;   // File offset of the first block
+} TraceHeader;
+
+// Open trace being written
+typedef struct {
+    int fd;                   // File descriptor (-1 when not recording)
+    int jointCount;
+    long long blockSize;
+    long long dataOffset;
+    long blocks;              // Blocks in the file, including the mapped one
+    unsigned char* block;     // Mapped last block (NULL before the first sample)
+    long samples;             // Samples written
+} JointTrace;
+
+/**
+ * Mark a trace as not recording (trace_record() and trace_close() then do nothing)
+ */
+void trace_init(JointTrace* trace);
+
+/**
+ * Create (or truncate) a trace file
+ * @param jointCount: Joints per sample, at most TRACE_MAX_JOINTS
+ * @return: 0 on success, -1 if the file cannot be written (reported with printf)
+ */
+int trace_open(JointTrace* trace, const char* path, int jointCount);
+
+/**
+ * Append one sample
+ * @param ballot: Ballot number (1-based, 0 before the first ballot)
+ * @param key: Key being worked on (0-9, 10 for confirm, -1 at rest)
+ * @param commanded: Target of each joint
+ * @param actual: Measured position of each joint (NAN when unknown)
+ * @return: 0 on success, -1 if the file could not grow (recording stops)
+ */
+int trace_record(JointTrace* trace, long long timeMs, int ballot, int key, const float* commanded, const float* actual);
+
+/**
+ * Unmap the last block and close the file
+ */
+void trace_close(JointTrace* trace);
+
+/**
+ * Print a trace as CSV: time_ms, ballot, key, cmd_j1.., act_j1.. (unknown positions left empty)
+ * @return: Number of samples printed, or -1 if the file is not a readable trace (reported with printf)
+ */
+long trace_dump_csv(const char* path, FILE* out);
+
+#endif
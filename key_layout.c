@@ -0,0 +1,214 @@
+/*
+ * Keypad Layouts
+ *
+ * Both default layouts are the forward kinematics of the joint angles the
+ * controllers were calibrated with, so they reproduce the original key poses.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "key_layout.h"
+#include "trajectory.h"
+
+// Name of each scene in layout files, indexed by Scene
+static const char* SCENE_NAMES[] = {"keypad", "chain"};
+
+// Keypad scene: tool on each key and lifted off it by the shoulder (digits 0-9, then confirm)
+const KeyLayout KEYPAD_LAYOUT = {
+    SCENE_KEYPAD,
+    PLAN_SETTLE_MS,
+    {
+        {{-0.031499, 0.009244, 0.537713}, {0, 0, 0}},   // 0
+        {{0.003207, -0.000681, 0.515418}, {0, 0, 0}},   // 1
+        {{0.004443, -0.001304, 0.501503}, {0, 0, 0}},   // 2
+        {{0.000682, -0.000221, 0.501536}, {0, 0, 0}},   // 3
+        {{-0.006057, 0.001287, 0.522892}, {0, 0, 0}},   // 4
+        {{-0.003977, 0.001167, 0.515408}, {0, 0, 0}},   // 5
+        {{-0.004911, 0.001685, 0.509906}, {0, 0, 0}},   // 6
+        {{-0.014288, 0.003035, 0.534234}, {0, 0, 0}},   // 7
+        {{-0.013566, 0.003981, 0.525817}, {0, 0, 0}},   // 8
+        {{-0.017773, 0.006098, 0.523223}, {0, 0, 0}},   // 9
+        {{-0.036755, 0.015216, 0.530485}, {0, 0, 0}},   // confirm
+    },
+    {
+        {{-0.013652, 0.004006, 0.538945}, {0, 0, 0}},   // 0
+        {{0.016635, -0.003534, 0.514998}, {0, 0, 0}},   // 1
+        {{0.031048, -0.009112, 0.499889}, {0, 0, 0}},   // 2
+        {{0.030776, -0.009994, 0.499889}, {0, 0, 0}},   // 3
+        {{0.036611, -0.007778, 0.520881}, {0, 0, 0}},   // 4
+        {{0.016318, -0.004789, 0.514998}, {0, 0, 0}},   // 5
+        {{0.022043, -0.007563, 0.509116}, {0, 0, 0}},   // 6
+        {{0.022606, -0.004802, 0.533777}, {0, 0, 0}},   // 7
+        {{0.003659, -0.001074, 0.526087}, {0, 0, 0}},   // 8
+        {{0.006478, -0.002223, 0.523673}, {0, 0, 0}},   // 9
+        {{0.119273, -0.049376, 0.508061}, {0, 0, 0}},   // confirm
+    }
+};
+
+// Six joint chain scene: approach pose of each key and the pose at the end of its press
+const KeyLayout CHAIN_LAYOUT = {
+    SCENE_CHAIN,
+    PLAN_SETTLE_MS,
+    {
+        {{-0.140258, 0.057421, 0.487611}, {0.002077, 0.015454, -0.919997}},   // 0
+        {{0.009821, -0.001991, 0.505748}, {0.100000, -0.710000, -0.200000}},   // 1
+        {{-0.090130, 0.025190, 0.488390}, {-0.001231, -0.015928, -0.730836}},   // 2
+        {{-0.068858, 0.023509, 0.483050}, {0.002260, -0.018279, -0.958907}},   // 3
+        {{-0.094019, 0.020937, 0.503336}, {0.002203, -0.020161, -0.726769}},   // 4
+        {{-0.091679, 0.029543, 0.503336}, {0.002203, -0.020161, -0.819399}},   // 5
+        {{-0.088646, 0.035688, 0.485509}, {0.003161, -0.019879, -1.004961}},   // 6
+        {{-0.123671, 0.033934, 0.503978}, {-0.005389, -0.051297, -0.640351}},   // 7
+        {{-0.118054, 0.044931, 0.495177}, {0.002496, -0.019308, -0.888968}},   // 8
+        {{-0.108691, 0.048814, 0.488862}, {0.001978, -0.016394, -1.042059}},   // 9
+        {{-0.135724, 0.077171, 0.467994}, {0.001671, -0.053276, -1.199858}},   // confirm
+    },
+    {
+        {{-0.140103, 0.057705, 0.490485}, {0.001509, -0.106014, -0.907465}},   // 0
+        {{0.009821, -0.001991, 0.505748}, {0.100000, -0.710000, -0.200000}},   // 1
+        {{-0.090130, 0.025190, 0.488390}, {-0.001231, -0.015928, -0.730836}},   // 2
+        {{-0.068451, 0.023949, 0.485027}, {0.000766, -0.101896, -0.934038}},   // 3
+        {{-0.093854, 0.021437, 0.505999}, {0.000624, -0.132916, -0.706161}},   // 4
+        {{-0.091450, 0.030178, 0.506643}, {-0.000120, -0.160369, -0.793697}},   // 5
+        {{-0.088360, 0.035977, 0.487111}, {0.002259, -0.087614, -0.988175}},   // 6
+        {{-0.123676, 0.034072, 0.505119}, {-0.005734, -0.099578, -0.635783}},   // 7
+        {{-0.117910, 0.045207, 0.497160}, {0.001753, -0.103152, -0.876852}},   // 8
+        {{-0.108397, 0.049151, 0.491062}, {0.000846, -0.109400, -1.024063}},   // 9
+        {{-0.135724, 0.077171, 0.467994}, {0.001671, -0.053276, -1.199858}},   // confirm
+    }
+};
+
+/**
+ * Solve one key pose, reporting it when it cannot be reached
+ */
+static int solve_target(const KeyLayout* layout, const ArmGeometry* geometry, const KeyTarget* target,
+                        const char* what, int key, const float* previous, float* joints) {
+    int jointCount = layout->scene == SCENE_CHAIN ? CHAIN_JOINTS : KEYPAD_JOINTS;
+    CartesianPose pose;
+
+    pose_from_rpy(&pose, target->position, target->rpy);
+    if (inverse_kinematics(geometry, &pose, jointCount, previous, joints) == -1) {
+        printf("ERROR: %s pose of key %d is out of reach (%.4f, %.4f, %.4f)\n",
+               what, key, target->position[0], target->position[1], target->position[2]);
+        return -1;
+    }
+    return 0;
+}
+
+int layout_solve(const KeyLayout* layout, const ArmGeometry* geometry, const float* start, KeySolutions* solutions) {
+    int key;
+
+    for (key = 0; key < KEY_COUNT; key++) {
+        float* hover = solutions->hover[key];
+        float* press = solutions->press[key];
+
+        memset(hover, 0, sizeof(solutions->hover[key]));
+        memset(press, 0, sizeof(solutions->press[key]));
+        if (solve_target(layout, geometry, &layout->hover[key], "Hover", key, start, hover) == -1 ||
+            solve_target(layout, geometry, &layout->press[key], "Press", key, hover, press) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int layout_load(KeyLayout* layout, const char* path) {
+    char line[512], name[16];
+    int key, seen = 0, lineNumber = 0, scene;
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL) {
+        printf("ERROR: Could not open layout %s\n", path);
+        return -1;
+    }
+
+    memset(layout, 0, sizeof(*layout));
+    layout->scene = -1;
+    layout->settleMs = PLAN_SETTLE_MS;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+            continue;
+        }
+        if (sscanf(line, "scene %15s", name) == 1) {
+            layout->scene = -1;
+            for (scene = SCENE_KEYPAD; scene <= SCENE_CHAIN; scene++) {
+                if (strcmp(name, SCENE_NAMES[scene]) == 0) {
+                    layout->scene = scene;
+                }
+            }
+        } else if (sscanf(line, "settle_ms %d", &layout->settleMs) == 1 && layout->settleMs >= 0) {
+            continue;
+        } else if (sscanf(line, "key %d", &key) == 1 && key >= 0 && key < KEY_COUNT) {
+            KeyTarget* hover = &layout->hover[key];
+            KeyTarget* press = &layout->press[key];
+            if (sscanf(line, "key %*d %f %f %f %f %f %f %f %f %f %f %f %f",
+                       &hover->position[0], &hover->position[1], &hover->position[2],
+                       &hover->rpy[0], &hover->rpy[1], &hover->rpy[2],
+                       &press->position[0], &press->position[1], &press->position[2],
+                       &press->rpy[0], &press->rpy[1], &press->rpy[2]) != 12) {
+                printf("ERROR: %s:%d: a key needs 12 values\n", path, lineNumber);
+                fclose(file);
+                return -1;
+            }
+            seen |= 1 << key;
+        } else {
+            printf("ERROR: %s:%d: unrecognized line\n", path, lineNumber);
+            fclose(file);
+            return -1;
+        }
+    }
+    fclose(file);
+
+    if (layout->scene == -1) {
+        printf("ERROR: %s does not name a known scene\n", path);
+        return -1;
+    }
+    if (seen != (1 << KEY_COUNT) - 1) {
+        printf("ERROR: %s does not describe all %d keys\n", path, KEY_COUNT);
+        return -1;
+    }
+    return 0;
+}
+
+int layout_save(const KeyLayout* layout, const char* path) {
+    FILE* file = fopen(path, "w");
+    int key, status;
+
+    if (file == NULL) {
+        return -1;
+    }
+    fprintf(file, "# Key layout: tool poses in metres and radians in the arm's base frame\n");
+    fprintf(file, "scene %s\n", SCENE_NAMES[layout->scene]);
+    fprintf(file, "settle_ms %d\n", layout->settleMs);
+    fprintf(file, "# key  hover: x y z roll pitch yaw  press: x y z roll pitch yaw\n");
+    for (key = 0; key < KEY_COUNT; key++) {
+        const KeyTarget* hover = &layout->hover[key];
+        const KeyTarget* press = &layout->press[key];
+        fprintf(file, "key %d  %.6f %.6f %.6f %.6f %.6f %.6f  %.6f %.6f %.6f %.6f %.6f %.6f\n", key,
+                hover->position[0], hover->position[1], hover->position[2], hover->rpy[0], hover->rpy[1], hover->rpy[2],
+                press->position[0], press->position[1], press->position[2], press->rpy[0], press->rpy[1], press->rpy[2]);
+    }
+    status = ferror(file) ? -1 : 0;
+    if (fclose(file) != 0) {
+        status = -1;
+    }
+    return status;
+}
+
+int layout_open(KeyLayout* layout, const char* path, int scene) {
+    if (path == NULL) {
+        *layout = scene == SCENE_CHAIN ? CHAIN_LAYOUT : KEYPAD_LAYOUT;
+    } else {
+        if (layout_load(layout, path) == -1) {
+            return -1;
+        }
+        if (layout->scene != scene) {
+            printf("ERROR: %s describes the %s scene, not the %s scene\n", path, SCENE_NAMES[layout->scene], SCENE_NAMES[scene]);
+            return -1;
+        }
+        printf("Using key layout %s (settle time %d ms)\n", path, layout->settleMs);
+    }
+    plan_set_settle_ms(layout->settleMs);
+    return 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * Keypad Layouts
+ *
+ * Describes where the keys of a voting panel are in Cartesian space instead
+ * of as calibrated joint angles. A layout gives, for every key, the tool
+ * pose on the key and the pose just off it; layout_solve() runs the inverse
+ * kinematics once at startup and caches the joint positions of every key,
+ * so moving the keypad means editing coordinates and nothing is solved
+ * while voting.
+ *
+ * Layouts can also be read from a text file (--layout, written by
+ * calibration_tuner), one line per key:
+ *
+ *   scene keypad
+ *   settle_ms 250
+ *   key <k> <hover x y z roll pitch yaw> <press x y z roll pitch yaw>
+ */
+
+#ifndef KEY_LAYOUT_H
+#define KEY_LAYOUT_H
+
+#include "kinematics.h"
+#include "key_transitions.h"
+
+// Key the keypad arm waits on before the first ballot (its press pose is the reference point)
+#define KEY_REFERENCE 5
+
+// Tool pose of one key in the arm's base frame
+typedef struct {
+    float position[3];    // Tool tip (metres)
+    float rpy[3];         // Roll, pitch, yaw of the tool (radians, ignored on the keypad scene)
+} KeyTarget;
+
+// Cartesian description of a voting panel
+typedef struct {
+    int scene;                      // SCENE_KEYPAD or SCENE_CHAIN
+    int settleMs;                   // Time allowed after every planned move (see plan_set_settle_ms())
+    KeyTarget hover[KEY_COUNT];     // Tool off the key: retracted after the press (keypad) or the approach (chain)
+    KeyTarget press[KEY_COUNT];     // Tool on the key
+} KeyLayout;
+
+// Joint positions of every key, indexed by Joint
+typedef struct {
+    float hover[KEY_COUNT][MAX_JOINTS];
+    float press[KEY_COUNT][MAX_JOINTS];
+} KeySolutions;
+
+// Layouts of the panels in the two scenes
+extern const KeyLayout KEYPAD_LAYOUT;
+extern const KeyLayout CHAIN_LAYOUT;
+
+/**
+ * Solve every key of a layout. The hover pose of each key is the solution
+ * closest to start and its press pose the one closest to the hover pose.
+ * @param start: Pose the arm starts from, indexed by Joint
+ * @return: 0 on success, -1 if a key is out of reach (reported with printf)
+ */
+int layout_solve(const KeyLayout* layout, const ArmGeometry* geometry, const float* start, KeySolutions* solutions);
+
+/**
+ * Read a layout file
+ * @return: 0 on success, -1 if the file is missing, malformed or lacks a key (reported with printf)
+ */
+int layout_load(KeyLayout* layout, const char* path);
+
+/**
+ * Write a layout file that layout_load() reads back
+ * @return: 0 on success, -1 on I/O error
+ */
+int layout_save(const KeyLayout* layout, const char* path);
+
+/**
+ * Pick the layout of a scene: the built-in one, or the file given with
+ * --layout. Its settle time becomes the one of every planned move.
+ * @param path: Layout file, or NULL for the built-in layout
+ * @return: 0 on success, -1 if the file cannot be used for this scene
+ */
+int layout_open(KeyLayout* layout, const char* path, int scene);
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * Key-to-Key Transition Table
+ *
+ * Both builders run once at startup; the controllers only look up
+ * table[from][to] while voting.
+ */
+
+#include <string.h>
+
+#include "key_transitions.h"
+
+void build_keypad_transitions(Transition table[KEY_COUNT][KEY_COUNT],
+                              const float numj3[], const float numj1[], const float backj2[],
+                              const float reference[]) {
+    float retract[KEYPAD_JOINTS];
+    int from, to;
+
+    for (from = 0; from < KEY_COUNT; from++) {
+        // Pose left behind by the press: joint 1 pressed, joint 2 lifted
+        retract[JOINT_1] = numj1[from];
+        retract[JOINT_2] = backj2[from];
+        retract[JOINT_3] = numj3[from];
+
+        for (to = 0; to < KEY_COUNT; to++) {
+            Transition* t = &table[from][to];
+
+            // The same key again: the tool is already lifted right above it
+            if (from == to) {
+                memcpy(t->via, retract, sizeof(retract));
+                continue;
+            }
+
+            // More negative joint 2 values lift the tool further from the keys
+            t->via[JOINT_1] = reference[JOINT_1];
+            t->via[JOINT_2] = backj2[from] < backj2[to] ? backj2[from] : backj2[to];
+            t->via[JOINT_3] = numj3[to];
+        }
+    }
+}
+
+void build_chain_transitions(Transition table[KEY_COUNT][KEY_COUNT],
+                             const float pressed[KEY_COUNT][CHAIN_JOINTS], const float approach[KEY_COUNT][CHAIN_JOINTS]) {
+    int from, to, j;
+
+    for (from = 0; from < KEY_COUNT; from++) {
+        // Keys pressed by their approach alone have no hover to go back to
+        int hover = memcmp(pressed[from], approach[from], sizeof(approach[from])) != 0;
+
+        for (to = 0; to < KEY_COUNT; to++) {
+            Transition* t = &table[from][to];
+
+            // The same key again only lifts back to where its press starts
+            for (j = 0; j < CHAIN_JOINTS; j++) {
+                t->via[j] = (from == to && hover) ? approach[from][j]
+                                                  : CHAIN_VIA_BLEND * (approach[from][j] + approach[to][j]) / 2;
+            }
+        }
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * Key-to-Key Transition Table
+ *
+ * Precomputed moves between any two keys of the voting panel (digits 0-9
+ * plus the confirm button). Each entry holds a safe via-pose that takes the
+ * arm from the retract pose of one key straight to the approach of the next
+ * one, so consecutive presses no longer return to the reference point or to
+ * the rest pose in between.
+ */
+
+#ifndef KEY_TRANSITIONS_H
+#define KEY_TRANSITIONS_H
+
+#include "niryo_arm.h"
+
+// Fraction of the key pose kept when the chain arm backs off towards rest
+#define CHAIN_VIA_BLEND 0.8f
+
+// Direct move from one key to the next
+typedef struct {
+    float via[MAX_JOINTS];   // Safe pose between the two keys (radians)
+} Transition;
+
+/**
+ * Build the table for the keypad scene (niryo_controller.c, Main/main.c).
+ * The via-pose keeps joint 2 at the higher of the two retract heights,
+ * turns joint 3 over the next key and puts joint 1 back at its reference
+ * value, which is where the approach of every key starts from. A repeated
+ * key stays on its retract pose, so pressing it again is only the joint 2
+ * press and retract.
+ * @param table: Table to fill, indexed [from][to]
+ * @param numj3, numj1, backj2: Calibration arrays with KEY_COUNT entries
+ * @param reference: Reference pose indexed by Joint
+ */
+void build_keypad_transitions(Transition table[KEY_COUNT][KEY_COUNT],
+                              const float numj3[], const float numj1[], const float backj2[],
+                              const float reference[]);
+
+/**
+ * Build the table for the six joint chain scene (vrep.cc).
+ * The via-pose is the midpoint of both key poses pulled towards the rest
+ * pose by CHAIN_VIA_BLEND, which backs the tool off the panel while it
+ * crosses over to the next key. A repeated key only lifts back to its
+ * approach pose and presses again, unless its approach already presses it.
+ * @param table: Table to fill, indexed [from][to]
+ * @param pressed: Pose of each key at the end of its press (radians)
+ * @param approach: Approach pose of each key (radians)
+ */
+void build_chain_transitions(Transition table[KEY_COUNT][KEY_COUNT],
+                             const float pressed[KEY_COUNT][CHAIN_JOINTS], const float approach[KEY_COUNT][CHAIN_JOINTS]);
+
+#endif
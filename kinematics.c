@@ -0,0 +1,246 @@
+/*
+ * Niryo One Kinematics
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "kinematics.h"
+
+// Joint values closer than this to a range limit still count as inside it
+#define RANGE_SLACK 1e-4f
+
+// Below this the wrist pitch is treated as straight and the two rolls as one axis
+#define WRIST_SINGULAR 1e-5f
+
+// Dimensions from the Niryo One URDF; ranges from its joint limits
+const ArmGeometry NIRYO_ONE_GEOMETRY = {
+    0.183f, 0.210f, 0.030f, 0.2215f, 0.0237f,
+    {-3.054f, -1.571f, -1.397f, -3.054f, -1.745f, -2.574f},
+    {3.054f, 0.640f, 1.571f, 3.054f, 1.919f, 2.574f}
+};
+
+typedef float Matrix[3][3];
+
+static void rotation_x(Matrix m, float angle) {
+    float c = cosf(angle), s = sinf(angle);
+    Matrix r = {{1, 0, 0}, {0, c, -s}, {0, s, c}};
+    memcpy(m, r, sizeof(Matrix));
+}
+
+static void rotation_y(Matrix m, float angle) {
+    float c = cosf(angle), s = sinf(angle);
+    Matrix r = {{c, 0, s}, {0, 1, 0}, {-s, 0, c}};
+    memcpy(m, r, sizeof(Matrix));
+}
+
+static void rotation_z(Matrix m, float angle) {
+    float c = cosf(angle), s = sinf(angle);
+    Matrix r = {{c, -s, 0}, {s, c, 0}, {0, 0, 1}};
+    memcpy(m, r, sizeof(Matrix));
+}
+
+// out = a * b (out may not alias a or b)
+static void multiply(Matrix out, const Matrix a, const Matrix b) {
+    int i, j, k;
+
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            out[i][j] = 0;
+            for (k = 0; k < 3; k++) {
+                out[i][j] += a[i][k] * b[k][j];
+            }
+        }
+    }
+}
+
+// out = transpose(a) * b
+static void multiply_transposed(Matrix out, const Matrix a, const Matrix b) {
+    int i, j, k;
+
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            out[i][j] = 0;
+            for (k = 0; k < 3; k++) {
+                out[i][j] += a[k][i] * b[k][j];
+            }
+        }
+    }
+}
+
+// Wrap an angle into (-pi, pi]
+static float wrap(float angle) {
+    while (angle > (float)M_PI) {
+        angle -= 2 * (float)M_PI;
+    }
+    while (angle <= -(float)M_PI) {
+        angle += 2 * (float)M_PI;
+    }
+    return angle;
+}
+
+// Orientation of the forearm frame: x along the forearm, z along the elbow offset
+static void forearm_rotation(Matrix m, float q1, float q2, float q3) {
+    Matrix yaw, pitch;
+
+    rotation_z(yaw, q1);
+    rotation_y(pitch, q2 + q3);
+    multiply(m, yaw, pitch);
+}
+
+// Distance from the elbow to the point solved by the arm joints, and the
+// angle between that segment and the elbow offset
+static void elbow_reach(const ArmGeometry* geometry, int jointCount, float* length, float* angle) {
+    // Without a wrist the tool tip sits on the forearm axis
+    float forearm = geometry->forearm + (jointCount == KEYPAD_JOINTS ? geometry->tool : 0);
+
+    *length = sqrtf(geometry->elbowOffset * geometry->elbowOffset + forearm * forearm);
+    *angle = atan2f(forearm, geometry->elbowOffset);
+}
+
+void pose_from_rpy(CartesianPose* pose, const float position[3], const float rpy[3]) {
+    Matrix yaw, pitch, roll, yawPitch;
+
+    rotation_z(yaw, rpy[2]);
+    rotation_y(pitch, rpy[1]);
+    rotation_x(roll, rpy[0]);
+    multiply(yawPitch, yaw, pitch);
+    multiply(pose->rotation, yawPitch, roll);
+    memcpy(pose->position, position, sizeof(pose->position));
+}
+
+void pose_to_rpy(const CartesianPose* pose, float rpy[3]) {
+    const float (*r)[3] = pose->rotation;
+
+    rpy[0] = atan2f(r[2][1], r[2][2]);
+    rpy[1] = atan2f(-r[2][0], sqrtf(r[0][0] * r[0][0] + r[1][0] * r[1][0]));
+    rpy[2] = atan2f(r[1][0], r[0][0]);
+}
+
+void forward_kinematics(const ArmGeometry* geometry, const float* joints, int jointCount, CartesianPose* pose) {
+    float q[MAX_JOINTS] = {0}, upper[3];
+    Matrix forearm, wrist, pitch, roll, temp;
+    int i;
+
+    memcpy(q, joints, jointCount * sizeof(float));
+    forearm_rotation(forearm, q[JOINT_1], q[JOINT_2], q[JOINT_3]);
+
+    // Wrist rotation: forearm roll, wrist pitch, tool roll
+    rotation_x(roll, q[JOINT_4]);
+    rotation_y(pitch, q[JOINT_5]);
+    multiply(temp, forearm, roll);
+    multiply(wrist, temp, pitch);
+    rotation_x(roll, q[JOINT_6]);
+    multiply(pose->rotation, wrist, roll);
+
+    // The upper arm leans forward with joint 2
+    upper[0] = sinf(q[JOINT_2]) * cosf(q[JOINT_1]);
+    upper[1] = sinf(q[JOINT_2]) * sinf(q[JOINT_1]);
+    upper[2] = cosf(q[JOINT_2]);
+
+    for (i = 0; i < 3; i++) {
+        pose->position[i] = (i == 2 ? geometry->baseHeight : 0) +
+                            geometry->upperArm * upper[i] +
+                            geometry->elbowOffset * forearm[i][2] +
+                            geometry->forearm * forearm[i][0] +
+                            geometry->tool * pose->rotation[i][0];
+    }
+}
+
+/**
+ * Keep a candidate if it is inside the joint ranges and closer to the previous pose than the best so far
+ */
+static void consider(const ArmGeometry* geometry, float* candidate, int jointCount,
+                     const float* previous, float* best, float* bestDistance) {
+    float distance = 0, delta;
+    int j;
+
+    for (j = 0; j < jointCount; j++) {
+        candidate[j] = wrap(candidate[j]);
+        if (candidate[j] < geometry->minAngle[j] - RANGE_SLACK || candidate[j] > geometry->maxAngle[j] + RANGE_SLACK) {
+            return;
+        }
+        delta = candidate[j] - previous[j];
+        distance += delta * delta;
+    }
+    if (*bestDistance < 0 || distance < *bestDistance) {
+        memcpy(best, candidate, jointCount * sizeof(float));
+        *bestDistance = distance;
+    }
+}
+
+int inverse_kinematics(const ArmGeometry* geometry, const CartesianPose* target, int jointCount,
+                       const float* previous, float* joints) {
+    float point[3], length, offsetAngle, horizontal, height, reach, cosine;
+    float candidate[MAX_JOINTS], bestDistance = -1;
+    int i, shoulder, elbow, wrist;
+
+    // Joints 1-3 place the wrist centre (or the tool tip when there is no wrist)
+    for (i = 0; i < 3; i++) {
+        point[i] = target->position[i];
+        if (jointCount == CHAIN_JOINTS) {
+            point[i] -= geometry->tool * target->rotation[i][0];
+        }
+    }
+    elbow_reach(geometry, jointCount, &length, &offsetAngle);
+
+    horizontal = sqrtf(point[0] * point[0] + point[1] * point[1]);
+    height = point[2] - geometry->baseHeight;
+    cosine = (horizontal * horizontal + height * height - geometry->upperArm * geometry->upperArm - length * length) /
+             (2 * geometry->upperArm * length);
+    if (cosine < -1 || cosine > 1) {
+        return -1;
+    }
+
+    for (shoulder = 0; shoulder < 2; shoulder++) {
+        // Facing the point, or facing away and leaning back over the base
+        float yaw = horizontal > WRIST_SINGULAR ? atan2f(point[1], point[0]) : previous[JOINT_1];
+        reach = horizontal;
+        if (shoulder == 1) {
+            yaw += (float)M_PI;
+            reach = -horizontal;
+        }
+
+        for (elbow = 0; elbow < 2; elbow++) {
+            float bend = elbow == 0 ? acosf(cosine) : -acosf(cosine);
+            Matrix forearm, rest;
+            float tilt, pitch;
+
+            candidate[JOINT_1] = yaw;
+            candidate[JOINT_2] = atan2f(reach, height) -
+                                 atan2f(length * sinf(bend), geometry->upperArm + length * cosf(bend));
+            candidate[JOINT_3] = bend - offsetAngle;
+
+            if (jointCount == KEYPAD_JOINTS) {
+                consider(geometry, candidate, jointCount, previous, joints, &bestDistance);
+                continue;
+            }
+
+            // Joints 4-6 turn the forearm frame onto the target: Rx(q4) Ry(q5) Rx(q6)
+            forearm_rotation(forearm, candidate[JOINT_1], candidate[JOINT_2], candidate[JOINT_3]);
+            multiply_transposed(rest, forearm, target->rotation);
+            tilt = rest[0][0] > 1 ? 1 : (rest[0][0] < -1 ? -1 : rest[0][0]);
+            pitch = acosf(tilt);
+
+            if (sinf(pitch) < WRIST_SINGULAR) {
+                // Straight wrist: keep joint 4 where it was and turn joint 6 alone
+                candidate[JOINT_4] = previous[JOINT_4];
+                candidate[JOINT_5] = pitch;
+                candidate[JOINT_6] = atan2f(rest[2][1], rest[1][1]) - previous[JOINT_4];
+                consider(geometry, candidate, jointCount, previous, joints, &bestDistance);
+                continue;
+            }
+
+            for (wrist = 0; wrist < 2; wrist++) {
+                float sign = wrist == 0 ? 1.0f : -1.0f;
+
+                candidate[JOINT_4] = atan2f(sign * rest[1][0], -sign * rest[2][0]);
+                candidate[JOINT_5] = sign * pitch;
+                candidate[JOINT_6] = atan2f(sign * rest[0][1], sign * rest[0][2]);
+                consider(geometry, candidate, jointCount, previous, joints, &bestDistance);
+            }
+        }
+    }
+
+    return bestDistance < 0 ? -1 : 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Niryo One Kinematics
+ *
+ * Forward and analytical inverse kinematics of the Niryo One chain: base
+ * yaw, shoulder and elbow pitch, then a wrist made of a forearm roll, a
+ * wrist pitch and a tool roll. The wrist axes cross at one point, so the
+ * position of that point gives joints 1-3 (two shoulder and two elbow
+ * solutions) and the remaining rotation gives joints 4-6 (two wrist
+ * solutions). Out of the solutions inside the joint ranges the one closest
+ * to the previous pose is returned.
+ *
+ * Base frame: x forward, y left, z up, origin on the floor under joint 1.
+ * At zero the upper arm is vertical and the forearm and tool point along x.
+ */
+
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include "niryo_arm.h"
+
+// Link lengths (metres) and joint ranges (radians) of an arm
+typedef struct {
+    float baseHeight;              // Floor to the shoulder axis
+    float upperArm;                // Shoulder axis to elbow axis
+    float elbowOffset;             // Elbow axis to the forearm axis, along the upper arm
+    float forearm;                 // Elbow to the wrist centre, along the forearm
+    float tool;                    // Wrist centre to the tool tip
+    float minAngle[MAX_JOINTS];
+    float maxAngle[MAX_JOINTS];
+} ArmGeometry;
+
+// Nominal Niryo One dimensions and joint ranges
+extern const ArmGeometry NIRYO_ONE_GEOMETRY;
+
+// Position and orientation of the tool tip in the base frame
+typedef struct {
+    float position[3];        // Metres
+    float rotation[3][3];     // Columns are the tool x (pointing direction), y and z axes
+} CartesianPose;
+
+/**
+ * Build a pose from a position and roll, pitch, yaw angles (R = Rz(yaw) Ry(pitch) Rx(roll))
+ */
+void pose_from_rpy(CartesianPose* pose, const float position[3], const float rpy[3]);
+
+/**
+ * Roll, pitch and yaw angles of a pose's orientation
+ */
+void pose_to_rpy(const CartesianPose* pose, float rpy[3]);
+
+/**
+ * Pose of the tool tip for the given joint positions
+ * @param jointCount: KEYPAD_JOINTS (joints 4-6 held at zero) or CHAIN_JOINTS
+ */
+void forward_kinematics(const ArmGeometry* geometry, const float* joints, int jointCount, CartesianPose* pose);
+
+/**
+ * Joint positions that put the tool tip on a pose
+ * @param jointCount: KEYPAD_JOINTS (position only, joints 4-6 held at zero) or CHAIN_JOINTS
+ * @param previous: Pose the arm comes from, used to pick among the solutions
+ * @param joints: Filled with jointCount positions
+ * @return: 0 on success, -1 if no solution is reachable within the joint ranges
+ */
+int inverse_kinematics(const ArmGeometry* geometry, const CartesianPose* target, int jointCount,
+                       const float* previous, float* joints);
+
+#endif
@@ -0,0 +1,314 @@
+/*
+ * Ballot Motion Programs
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "motion_program.h"
+#include "trajectory.h"
+
+// Header of a saved program
+typedef struct {
+    char magic[4];
+    int version;
+    int scene;
+    int stepSize;
+    long long ballots;
+    long long count;
+} ProgramHeader;
+
+void program_init(MotionProgram* program, int scene) {
+    program->scene = scene;
+    program->ballots = 0;
+    program->count = 0;
+    program->capacity = 0;
+    program->steps = NULL;
+    program->merged = 0;
+    program->lastKey = NO_KEY;
+    program->pendingMark = MARK_NONE;
+    program->knownMask = 0;
+    memset(program->commanded, 0, sizeof(program->commanded));
+}
+
+void program_set_start(MotionProgram* program, const float* pose, int mask) {
+    int j;
+
+    for (j = 0; j < MAX_JOINTS; j++) {
+        if (mask & JOINT_MASK(j)) {
+            program->commanded[j] = pose[j];
+        }
+    }
+    program->knownMask |= mask;
+}
+
+void program_free(MotionProgram* program) {
+    free(program->steps);
+    program->steps = NULL;
+    program->count = 0;
+    program->capacity = 0;
+}
+
+void program_clear(MotionProgram* program) {
+    program->count = 0;
+}
+
+/**
+ * Append a move, leaving out the joints already commanded to the same target
+ * @param phase: ArmPhase the move is counted in
+ * @return: The new step, or NULL if the move was merged away
+ */
+static MotionStep* emit(MotionProgram* program, int mask, const float* targets, int phase) {
+    MotionStep* step;
+    int j, moved = 0;
+
+    for (j = 0; j < MAX_JOINTS; j++) {
+        if ((mask & JOINT_MASK(j)) && (!(program->knownMask & JOINT_MASK(j)) || program->commanded[j] != targets[j])) {
+            moved |= JOINT_MASK(j);
+        }
+    }
+    if (moved == 0) {
+        program->merged++;
+        return NULL;
+    }
+
+    if (program->count == program->capacity) {
+        program->capacity = program->capacity ? program->capacity * 2 : 256;
+        program->steps = (MotionStep*)realloc(program->steps, program->capacity * sizeof(MotionStep));
+    }
+    step = &program->steps[program->count++];
+    memset(step, 0, sizeof(*step));
+    step->mask = (unsigned char)moved;
+    step->mark = (signed char)program->pendingMark;
+    step->phase = (unsigned char)phase;
+    step->timeoutMs = plan_duration_ms(program->commanded, targets, moved, &NIRYO_ONE_LIMITS);
+    for (j = 0; j < MAX_JOINTS; j++) {
+        if (moved & JOINT_MASK(j)) {
+            step->targets[j] = targets[j];
+            program->commanded[j] = targets[j];
+        }
+    }
+    program->knownMask |= moved;
+    program->pendingMark = MARK_NONE;
+    return step;
+}
+
+/**
+ * Append the moves of one key press, starting from the previous key
+ */
+static void emit_key(MotionProgram* program, const PoseTable* table, int key) {
+    long first = program->count;
+    MotionStep* step;
+    int p, press = table->phaseCount[key] > 1 ? 1 : 0;
+
+    program->pendingMark = key;
+    if (program->lastKey != NO_KEY) {
+        const Transition* t = &table->transitions[program->lastKey][key];
+        emit(program, ALL_JOINTS, t->via, key == KEY_CONFIRM ? PHASE_CONFIRM : PHASE_APPROACH);
+    }
+    // Press sequences are approach, press, then any retract (one phase: the approach presses)
+    for (p = 0; p < table->phaseCount[key]; p++) {
+        const MotionPhase* phase = &table->keys[key][p];
+        step = emit(program, phase->mask, phase->targets,
+                    key == KEY_CONFIRM ? PHASE_CONFIRM : p < PHASE_RETRACT ? PHASE_APPROACH + p : PHASE_RETRACT);
+
+        // If the arm was already on the press pose, the last move of the key got it there
+        if (p == press && step == NULL && program->count > first) {
+            step = &program->steps[program->count - 1];
+        }
+        if (p == press && step != NULL) {
+            step->flags |= STEP_PRESS;
+            // A digit press merged into the move that reached it still counts as the press
+            if (key != KEY_CONFIRM) {
+                step->phase = PHASE_PRESS;
+            }
+        }
+    }
+    program->lastKey = key;
+}
+
+int program_add_ballot(MotionProgram* program, const PoseTable* table, const char* digits, size_t length) {
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        if (digits[i] < '0' || digits[i] > '9') {
+            return -1;
+        }
+    }
+    for (i = 0; i < length; i++) {
+        emit_key(program, table, digits[i] - '0');
+    }
+    emit_key(program, table, KEY_CONFIRM);
+    program->ballots++;
+    return 0;
+}
+
+void program_add_home(MotionProgram* program, const PoseTable* table) {
+    int p;
+
+    program->pendingMark = NO_KEY;
+    for (p = 0; p < table->homeCount; p++) {
+        emit(program, table->home[p].mask, table->home[p].targets, PHASE_HOME);
+    }
+    program->lastKey = NO_KEY;
+}
+
+int program_save(const MotionProgram* program, const char* path) {
+    ProgramHeader header;
+    FILE* file = fopen(path, "wb");
+    int ok;
+
+    if (file == NULL) {
+        return -1;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PROGRAM_MAGIC, 4);
+    header.version = PROGRAM_VERSION;
+    header.scene = program->scene;
+    header.stepSize = sizeof(MotionStep);
+    header.ballots = program->ballots;
+    header.count = program->count;
+
+    ok = fwrite(&header, sizeof(header), 1, file) == 1
+         && (program->count == 0 || fwrite(program->steps, sizeof(MotionStep), program->count, file) == (size_t)program->count);
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    return ok ? 0 : -1;
+}
+
+int program_load(MotionProgram* program, const char* path) {
+    ProgramHeader header;
+    FILE* file = fopen(path, "rb");
+
+    if (file == NULL) {
+        return -1;
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, PROGRAM_MAGIC, 4) != 0
+        || header.version != PROGRAM_VERSION || header.stepSize != (int)sizeof(MotionStep) || header.count < 0) {
+        printf("ERROR: %s is not a motion program\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    program_free(program);
+    program_init(program, header.scene);
+    program->ballots = (long)header.ballots;
+    program->capacity = (long)header.count;
+    program->steps = (MotionStep*)malloc((header.count ? header.count : 1) * sizeof(MotionStep));
+    if (program->steps == NULL || fread(program->steps, sizeof(MotionStep), header.count, file) != (size_t)header.count) {
+        printf("ERROR: %s is truncated\n", path);
+        program_free(program);
+        fclose(file);
+        return -1;
+    }
+    program->count = (long)header.count;
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Give up the ballot of a key whose press failed: lift straight off the key
+ * and pass over the rest of the ballot, its confirm key included. The pose
+ * the skipped steps would have left the arm on goes to arm->resyncPose, and
+ * the next step run on the arm, in this program or the next one, sends it
+ * whole.
+ * @param i: Step of the failed press
+ * @return: Last step skipped
+ */
+static long skip_ballot(NiryoArm* arm, const MotionProgram* program, long i, int key) {
+    const MotionStep* step;
+    float* expected = arm->resyncPose;
+    int j, lifted = 0, confirmed = key == KEY_CONFIRM;
+
+    memcpy(expected, arm->targets, MAX_JOINTS * sizeof(float));
+    for (i++; i < program->count; i++) {
+        step = &program->steps[i];
+        if (step->mark != MARK_NONE) {
+            if (confirmed) {
+                break;
+            }
+            confirmed = step->mark == KEY_CONFIRM;
+        }
+        for (j = 0; j < MAX_JOINTS; j++) {
+            if (step->mask & JOINT_MASK(j)) {
+                expected[j] = step->targets[j];
+            }
+        }
+    }
+
+    if (arm->keyHover != NULL) {
+        for (j = 0; j < arm->jointCount; j++) {
+            if (arm->keyHover[key][j] != arm->targets[j]) {
+                lifted |= JOINT_MASK(j);
+            }
+        }
+        if (lifted != 0) {
+            arm_move_planned(arm, arm->keyHover[key], lifted);
+        }
+    }
+    arm_abort_ballot(arm);
+    arm->resyncPending = 1;
+    return i - 1;
+}
+
+long program_run(NiryoArm* arm, const MotionProgram* program) {
+    const MotionStep* step;
+    const float* targets;
+    float resume[MAX_JOINTS];
+    long i, resumeStep = 0, late = 0;
+    int ret, key = NO_KEY, mask, timeout, j;
+    int all = (1 << arm->jointCount) - 1;
+
+    if (program->scene != arm->scene) {
+        printf("ERROR: Motion program was compiled for another scene\n");
+        return -1;
+    }
+    memcpy(resume, arm->targets, sizeof(resume));
+    for (i = 0; i < program->count; i++) {
+        step = &program->steps[i];
+        if (step->mark != MARK_NONE) {
+            // Steps of a key only make sense from the pose the key started from
+            resumeStep = i;
+            memcpy(resume, arm->targets, sizeof(resume));
+            arm_mark(arm, step->mark);
+            key = step->mark;
+        }
+        arm->phase = step->phase;
+        targets = step->targets;
+        mask = step->mask;
+        timeout = step->timeoutMs;
+        if (arm->resyncPending) {
+            // The step was compiled for the pose of the skipped ones: send every joint
+            for (j = 0; j < MAX_JOINTS; j++) {
+                if (mask & JOINT_MASK(j)) {
+                    arm->resyncPose[j] = targets[j];
+                }
+            }
+            targets = arm->resyncPose;
+            mask = all;
+            timeout = plan_duration_ms(arm->targets, arm->resyncPose, all, &NIRYO_ONE_LIMITS);
+        }
+        if (step->flags & STEP_PRESS) {
+            ret = arm_press(arm, key, targets, mask, timeout);
+        } else {
+            ret = arm_move_pose(arm, targets, mask, timeout);
+        }
+        if (ret != ARM_LINK_LOST) {
+            arm->resyncPending = 0;
+        }
+        if (ret == ARM_LINK_LOST) {
+            if (arm_recover(arm, resume) == -1) {
+                return -1;
+            }
+            i = resumeStep - 1;
+        } else if (ret == ARM_PRESS_FAILED) {
+            // A missed or wrong key spoils the ballot: it must not be confirmed
+            i = skip_ballot(arm, program, i, key);
+        } else if (ret == -1) {
+            late++;
+        }
+    }
+    return late;
+}
@@ -0,0 +1,136 @@
+/*
+ * Ballot Motion Programs
+ *
+ * Compiles voting sequences ahead of time into a flat array of motion steps
+ * (joint mask, targets, time limit) built from one pose table per scene.
+ * The compiler tracks the last commanded target of every joint, so joints
+ * that would be sent the position they already hold are left out of a step
+ * and steps left with no joint are merged into the next one. The time limit
+ * of every step is planned from the commanded pose to the new targets
+ * (trajectory.h). Executing a program is then a plain loop over
+ * arm_move_pose().
+ *
+ * Programs can be saved to a binary file (native byte order) and loaded
+ * later, so a batch of ballots is validated and optimized once.
+ */
+
+#ifndef MOTION_PROGRAM_H
+#define MOTION_PROGRAM_H
+
+#include <stddef.h>
+
+#include "niryo_arm.h"
+#include "key_transitions.h"
+
+// Most phases a key press or the return home can have
+#define MAX_KEY_PHASES 4
+
+// Step that does not start a new key
+#define MARK_NONE -2
+
+// File signature and format version of saved programs
+#define PROGRAM_MAGIC "NMP1"
+#define PROGRAM_VERSION 3
+
+// Step flags: the step presses the key of its mark (run with arm_press())
+#define STEP_PRESS 1
+
+// One move of a key press: joints sent together, then waited for
+typedef struct {
+    int mask;                    // Joints to move (JOINT_MASK(...) combination)
+    float targets[MAX_JOINTS];   // Target positions indexed by Joint (radians)
+} MotionPhase;
+
+// Everything the compiler needs to know about a scene
+typedef struct {
+    int scene;                                         // SCENE_KEYPAD or SCENE_CHAIN
+    int phaseCount[KEY_COUNT];                         // Phases used by each key
+    MotionPhase keys[KEY_COUNT][MAX_KEY_PHASES];       // Press sequence of each key
+    int homeCount;                                     // Phases of the return home
+    MotionPhase home[MAX_KEY_PHASES];                  // Sequence leaving the keypad
+    Transition transitions[KEY_COUNT][KEY_COUNT];      // Direct moves between keys
+} PoseTable;
+
+// One record of a program (32 bytes)
+typedef struct {
+    unsigned char mask;          // Joints to move and wait for
+    signed char mark;            // Key passed to arm_mark() before the step, or MARK_NONE
+    unsigned char phase;         // ArmPhase the move is counted in
+    unsigned char flags;         // STEP_PRESS
+    int timeoutMs;               // Planned duration of the move plus settling time
+    float targets[MAX_JOINTS];   // Target positions of the masked joints
+} MotionStep;
+
+// Compiled program plus the compiler state used while appending to it
+typedef struct {
+    int scene;                        // Scene the program was compiled for
+    long ballots;                     // Ballots compiled into the program
+    long count;                       // Steps in use
+    long capacity;                    // Steps allocated
+    MotionStep* steps;
+    long merged;                      // Steps removed because they moved nothing new
+    int lastKey;                      // Key the arm ends on (NO_KEY at rest)
+    int pendingMark;                  // Mark waiting for the next emitted step
+    int knownMask;                    // Joints whose commanded target is known
+    float commanded[MAX_JOINTS];      // Last commanded target of each joint (unknown joints: 0, the rest pose)
+} MotionProgram;
+
+/**
+ * Start an empty program for a scene
+ */
+void program_init(MotionProgram* program, int scene);
+
+/**
+ * Tell the compiler where the arm stands before the first step
+ * @param pose: Positions indexed by Joint (only masked joints are read)
+ */
+void program_set_start(MotionProgram* program, const float* pose, int mask);
+
+/**
+ * Release the steps of a program
+ */
+void program_free(MotionProgram* program);
+
+/**
+ * Drop the compiled steps but keep the compiler state, so the next ballot
+ * continues from where the arm was left (used to compile one ballot at a time)
+ */
+void program_clear(MotionProgram* program);
+
+/**
+ * Append one ballot (its digits followed by the confirm key)
+ * @param digits: Ballot digits, not null terminated
+ * @return: 0 on success, -1 if the ballot has a non-digit character (nothing is appended)
+ */
+int program_add_ballot(MotionProgram* program, const PoseTable* table, const char* digits, size_t length);
+
+/**
+ * Append the return home that ends a voting session
+ */
+void program_add_home(MotionProgram* program, const PoseTable* table);
+
+/**
+ * Write a program to a binary file
+ * @return: 0 on success, -1 on I/O error
+ */
+int program_save(const MotionProgram* program, const char* path);
+
+/**
+ * Read a program written by program_save() (replaces the content of program)
+ * @return: 0 on success, -1 if the file is missing, truncated or not a program
+ */
+int program_load(MotionProgram* program, const char* path);
+
+/**
+ * Execute every step of a program on the arm. If the link drops, the arm is
+ * recovered (arm_recover()) onto the pose the interrupted key started from
+ * and the program resumes at that key. If a press fails (ARM_PRESS_FAILED),
+ * the arm lifts off the key, the rest of the ballot is skipped without its
+ * confirm (arm_abort_ballot()) and the next key starts with every joint sent,
+ * also when it comes in the next program run on the arm (arm->resyncPending).
+ * @return: Number of steps whose joints did not arrive in time, or -1 if the
+ *          program was compiled for another scene or the link could not be restored
+ */
+long program_run(NiryoArm* arm, const MotionProgram* program);
+
+#endif
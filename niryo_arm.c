@@ -0,0 +1,955 @@
+/*
+ * Niryo One Arm Session
+ *
+ * One arm of the scene as the voting controllers drive it: the connection,
+ * with joint handles resolved once and the link recovered when it drops;
+ * moves sent through a window of in-flight commands, leaving out joints
+ * already on target; presses checked on the keypad signal and made again
+ * when missed; and the key and ballot marks the latency stats are kept by.
+ */
+
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "niryo_arm.h"
+#include "trajectory.h"
+
+/**
+ * Build the scene path of a joint, e.g. /base_link_respondable[0]/joint_3
+ * or /NiryoOne/Joint/Link/Joint for the second joint of the chain scene
+ */
+static void joint_path(const NiryoArm* arm, int joint, simxChar* name, size_t size) {
+    int k;
+
+    if (arm->scene == SCENE_CHAIN) {
+        snprintf(name, size, "/NiryoOne/Joint");
+        for (k = 0; k < joint; k++) {
+            strncat(name, "/Link/Joint", size - strlen(name) - 1);
+        }
+    } else {
+        snprintf(name, size, "/base_link_respondable[%d]/joint_%d", arm->instance, joint + 1);
+    }
+}
+
+/**
+ * Record a remote call and how long it blocked on the session clock
+ */
+static void count_call(NiryoArm* arm, int call, long long startMs) {
+    hist_record(&arm->stats.calls[call], clock_now_ms(&arm->clock) - startMs);
+}
+
+/**
+ * Append a trace sample: the current targets against the given positions
+ */
+static void record_sample(NiryoArm* arm, const float* actual) {
+    int ballot = (int)arm->stats.ballots.count + (arm->stats.ballotStartMs >= 0 ? 1 : 0);
+
+    trace_record(&arm->trace, clock_now_ms(&arm->clock), ballot, arm->stats.markKey, arm->targets, actual);
+}
+
+/**
+ * Read the streamed position of every joint and append it to the trace
+ */
+static void trace_sample(NiryoArm* arm) {
+    float position, actual[MAX_JOINTS];
+    long long start;
+    int j;
+
+    if (arm->trace.fd == -1) {
+        return;
+    }
+    for (j = 0; j < arm->jointCount; j++) {
+        start = clock_now_ms(&arm->clock);
+        actual[j] = Link::read_position(arm->clientID, arm->handles[j], &position) == simx_return_ok ? position : NAN;
+        count_call(arm, CALL_GET_POSITION, start);
+    }
+    record_sample(arm, actual);
+}
+
+/**
+ * Name of the signal the keypad of the arm counts its presses in,
+ * e.g. keypadPress[0], or chainPress on the chain scene
+ */
+static void press_signal(const NiryoArm* arm, simxChar* name, size_t size) {
+    if (arm->scene == SCENE_CHAIN) {
+        snprintf(name, size, "chainPress");
+    } else {
+        snprintf(name, size, "keypadPress[%d]", arm->instance);
+    }
+}
+
+/**
+ * Read the press count and last pressed key from the keypad signal
+ * (presses * 16 + key, streamed since the handles were resolved)
+ * @return: 0 on success, -1 if the signal has no value yet
+ */
+static int read_press(NiryoArm* arm, int* presses, int* key) {
+    simxChar name[32];
+    long long start = clock_now_ms(&arm->clock);
+    int ret, value;
+
+    press_signal(arm, name, sizeof(name));
+    ret = Link::read_signal(arm->clientID, name, &value);
+    count_call(arm, CALL_GET_SIGNAL, start);
+    if (ret != simx_return_ok) {
+        return -1;
+    }
+    *presses = value / 16;
+    *key = value % 16;
+    return 0;
+}
+
+/**
+ * Check whether the keypad registered the watched key since the current key started
+ */
+static int press_registered(NiryoArm* arm) {
+    int presses, key;
+
+    return arm->pressBaseline >= 0 && read_press(arm, &presses, &key) == 0
+           && presses > arm->pressBaseline && key == arm->pressWatch;
+}
+
+/**
+ * Report a command that failed, with its number and send time
+ */
+static void report_command(NiryoArm* arm, const ArmCommand* command, int flags) {
+    arm->commandErrors++;
+    printf("ERROR: Command #%ld (joint %d -> %.4f, sent at %lld ms) failed with code 0x%x\n",
+           command->seq, command->joint + 1, command->target, command->issuedMs, flags);
+}
+
+/**
+ * Mark commands as acknowledged, keeping only the joints outside mask in flight
+ */
+static void acknowledge(NiryoArm* arm, int mask) {
+    long long now = clock_now_ms(&arm->clock);
+    int i, kept = 0;
+
+    for (i = 0; i < arm->inFlight; i++) {
+        if (mask & JOINT_MASK(arm->pending[i].joint)) {
+            if (now - arm->pending[i].issuedMs > arm->maxAckMs) {
+                arm->maxAckMs = now - arm->pending[i].issuedMs;
+            }
+        } else {
+            arm->pending[kept++] = arm->pending[i];
+        }
+    }
+    arm->inFlight = kept;
+}
+
+/**
+ * Send one joint command and attribute the error flags of the reply.
+ * A oneshot call returns the reply of the previous command sent to the same
+ * joint, so remote errors belong to that command, while local errors belong
+ * to the one being sent. Oneshot commands are tracked in arm->pending when
+ * pipelining is enabled.
+ * @param oneshot: 1 to send without waiting (always the case inside a paused batch)
+ */
+static int send_target(NiryoArm* arm, int joint, float position, int oneshot) {
+    ArmCommand command;
+    int ret, failed;
+
+    command.seq = ++arm->commandsSent;
+    command.joint = joint;
+    command.target = position;
+    command.issuedMs = clock_now_ms(&arm->clock);
+
+    // The joint is on its way until a wait sees it arrive
+    arm->settledMask &= ~JOINT_MASK(joint);
+
+    ret = Link::set_target(arm->clientID, arm->handles[joint], position, !oneshot);
+    count_call(arm, CALL_SET_TARGET, command.issuedMs);
+    if (!oneshot) {
+        if (ret != simx_return_ok) {
+            report_command(arm, &command, ret);
+        } else {
+            arm->commandedMask |= JOINT_MASK(joint);
+        }
+        return ret;
+    }
+
+    if ((ret & simx_return_remote_error_flag) && arm->lastCommand[joint].seq > 0) {
+        report_command(arm, &arm->lastCommand[joint], simx_return_remote_error_flag);
+    }
+    failed = ret & ~(simx_return_novalue_flag | simx_return_remote_error_flag);
+    if (failed) {
+        report_command(arm, &command, failed);
+        return failed;
+    }
+
+    arm->lastCommand[joint] = command;
+    arm->commandedMask |= JOINT_MASK(joint);
+    if (arm->inFlightLimit > 0) {
+        arm->pending[arm->inFlight++] = command;
+    }
+    return simx_return_ok;
+}
+
+/**
+ * Make room in the window for n more commands
+ */
+static void reserve(NiryoArm* arm, int n) {
+    if (arm->inFlightLimit > 0 && arm->inFlight + n > arm->inFlightLimit) {
+        arm_sync_commands(arm);
+    }
+}
+
+void arm_init(NiryoArm* arm, int scene) {
+    int j;
+
+    arm->clientID = -1;
+    arm->host = DEFAULT_HOST;
+    arm->port = DEFAULT_PORT;
+    arm->connectionID = -1;
+    arm->scene = scene;
+    arm->jointCount = (scene == SCENE_CHAIN) ? CHAIN_JOINTS : KEYPAD_JOINTS;
+    arm->instance = 0;
+    arm->waitMode = WAIT_CONVERGE;
+    arm->tolerance = DEFAULT_TOLERANCE;
+    clock_init(&arm->clock, CLOCK_REAL, DEFAULT_STEP_MS);
+    arm->compileTo = NULL;
+    arm->programFrom = NULL;
+    arm->layoutFrom = NULL;
+    arm->traceTo = NULL;
+    arm->journalTo = NULL;
+    arm->arms = 1;
+    arm->inFlightLimit = DEFAULT_IN_FLIGHT;
+    arm->reconnects = DEFAULT_RECONNECTS;
+    arm->ballotCacheKb = DEFAULT_BALLOT_CACHE_KB;
+    arm->detectPress = 0;
+    arm->pressWatch = NO_KEY;
+    arm->pressBaseline = -1;
+    arm->keyHover = NULL;
+    arm->resyncPending = 0;
+    arm->elide = 1;
+    arm->commandedMask = 0;
+    arm->settledMask = 0;
+    arm->inFlight = 0;
+    arm->commandsSent = 0;
+    arm->commandErrors = 0;
+    arm->maxAckMs = 0;
+    arm->phase = PHASE_HOME;
+    memset(&arm->stats, 0, sizeof(arm->stats));
+    arm->stats.markKey = NO_KEY;
+    arm->stats.ballotStartMs = -1;
+    memset(arm->lastCommand, 0, sizeof(arm->lastCommand));
+    trace_init(&arm->trace);
+    for (j = 0; j < MAX_JOINTS; j++) {
+        arm->handles[j] = -1;
+        arm->targets[j] = 0;
+        arm->measured[j] = 0;
+    }
+}
+
+int arm_parse_options(NiryoArm* arm, int argc, char* argv[], const char** input) {
+    const char* replayFrom = NULL;
+    int i, replaySpeed = REPLAY_FAST;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--fixed-dwell") == 0) {
+            arm->waitMode = WAIT_FIXED;
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            arm->tolerance = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--clock") == 0 && i + 1 < argc && clock_mode_from_name(argv[i + 1]) != -1) {
+            arm->clock.mode = clock_mode_from_name(argv[++i]);
+        } else if (strcmp(argv[i], "--step-ms") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            arm->clock.stepMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--compile") == 0 && i + 1 < argc) {
+            arm->compileTo = argv[++i];
+        } else if (strcmp(argv[i], "--program") == 0 && i + 1 < argc) {
+            arm->programFrom = argv[++i];
+        } else if (strcmp(argv[i], "--arms") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            arm->arms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--in-flight") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+            arm->inFlightLimit = atoi(argv[++i]) < MAX_IN_FLIGHT ? atoi(argv[i]) : MAX_IN_FLIGHT;
+        } else if (strcmp(argv[i], "--layout") == 0 && i + 1 < argc) {
+            arm->layoutFrom = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            arm->traceTo = argv[++i];
+        } else if (strcmp(argv[i], "--reconnect") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+            arm->reconnects = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+            arm->journalTo = argv[++i];
+        } else if (strcmp(argv[i], "--ballot-cache") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+            arm->ballotCacheKb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--detect-press") == 0) {
+            arm->detectPress = 1;
+        } else if (strcmp(argv[i], "--no-elide") == 0) {
+            arm->elide = 0;
+        } else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+            arm->host = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            arm->port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            // Backends are compiled in (transport.h), so only the built one can be asked for
+            if (strcmp(argv[++i], Link::name()) != 0) {
+                printf("ERROR: This build talks to the '%s' backend, not '%s' (rebuild with -DTRANSPORT_BACKEND=%s)\n",
+                       Link::name(), argv[i], strcmp(argv[i], "sim") == 0 ? "TRANSPORT_SIM -Iextapi_sim"
+                       : strcmp(argv[i], "replay") == 0 ? "TRANSPORT_REPLAY" : "TRANSPORT_REMOTE_API");
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            if (call_log_record(argv[++i], Link::name()) == -1) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayFrom = argv[++i];
+        } else if (strcmp(argv[i], "--replay-speed") == 0 && i + 1 < argc
+                   && (strcmp(argv[i + 1], "fast") == 0 || strcmp(argv[i + 1], "recorded") == 0)) {
+            replaySpeed = strcmp(argv[++i], "recorded") == 0 ? REPLAY_RECORDED : REPLAY_FAST;
+        } else if (argv[i][0] != '-') {
+            *input = argv[i];
+        } else {
+            printf("ERROR: Unknown option '%s'\n", argv[i]);
+            printf("Usage: %s [--fixed-dwell] [--tolerance <radians>] [--clock real|sync|virtual] [--step-ms <ms>] [--compile <out> | --program <in>] [--arms <n>] [--in-flight <n>] [--layout <file>] [--trace <file>] [--reconnect <n>] [--journal <file>] [--ballot-cache <KiB>] [--detect-press] [--no-elide] [--host <address>] [--port <n>] [--backend remote|sim|replay] [--record <file>] [--replay <file> [--replay-speed fast|recorded]] [votes file]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    // Only a replay build answers from a call log
+    if (replayFrom != NULL) {
+        if (TRANSPORT_BACKEND != TRANSPORT_REPLAY) {
+            printf("ERROR: --replay needs a build with -DTRANSPORT_BACKEND=TRANSPORT_REPLAY\n");
+            return -1;
+        }
+        if (call_log_replay(replayFrom, replaySpeed) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int arm_connect(NiryoArm* arm, const char* host, int port, int instance) {
+    long long start;
+
+    arm->instance = instance;
+    arm->host = host;
+    arm->port = port;
+
+    // The clock records its own calls (the arm may have been copied since arm_init)
+    arm->clock.calls = arm->stats.calls;
+    start = clock_now_ms(&arm->clock);
+    arm->clientID = Link::connect(host, port);
+    count_call(arm, CALL_START, start);
+    if (arm->clientID == -1) {
+        return -1;
+    }
+    if (clock_start(&arm->clock, arm->clientID) == -1) {
+        arm_disconnect(arm);
+        return -1;
+    }
+    clock_sleep_ms(&arm->clock, 500);
+
+    if (arm_resolve_handles(arm) == -1) {
+        arm_disconnect(arm);
+        return -1;
+    }
+
+    if (arm->traceTo != NULL) {
+        char path[512];
+        if (arm->arms > 1) {
+            snprintf(path, sizeof(path), "%s.%d", arm->traceTo, instance);
+        } else {
+            snprintf(path, sizeof(path), "%s", arm->traceTo);
+        }
+        if (trace_open(&arm->trace, path, arm->jointCount) == -1) {
+            arm_disconnect(arm);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int arm_resolve_handles(NiryoArm* arm) {
+    simxChar handlerName[150];
+    long long start;
+    int j, ret;
+
+    // Nothing is known about the joints on a new connection
+    arm->commandedMask = 0;
+    arm->settledMask = 0;
+
+    for (j = 0; j < arm->jointCount; j++) {
+        joint_path(arm, j, handlerName, sizeof(handlerName));
+        start = clock_now_ms(&arm->clock);
+        ret = Link::get_handle(arm->clientID, handlerName, &arm->handles[j]);
+        count_call(arm, CALL_GET_HANDLE, start);
+        if (ret != simx_return_ok) {
+            printf("ERROR: Could not resolve handle for %s\n", handlerName);
+            arm->handles[j] = -1;
+            return -1;
+        }
+
+        // Subscribe to the joint position so waits only read the local buffer
+        start = clock_now_ms(&arm->clock);
+        Link::stream_position(arm->clientID, arm->handles[j]);
+        count_call(arm, CALL_GET_POSITION, start);
+    }
+
+    // Subscribe to the press signal of the keypad the same way
+    if (arm->detectPress) {
+        press_signal(arm, handlerName, sizeof(handlerName));
+        start = clock_now_ms(&arm->clock);
+        Link::stream_signal(arm->clientID, handlerName);
+        count_call(arm, CALL_GET_SIGNAL, start);
+    }
+
+    arm->connectionID = Link::connection_id(arm->clientID);
+    return 0;
+}
+
+int arm_refresh_handles(NiryoArm* arm) {
+    int connectionID = Link::connection_id(arm->clientID);
+
+    if (connectionID == -1) {
+        return -1;
+    }
+    if (connectionID != arm->connectionID) {
+        printf("Connection changed, resolving joint handles again...\n");
+        return arm_resolve_handles(arm);
+    }
+    return 0;
+}
+
+int arm_set_joint(NiryoArm* arm, int joint, float position) {
+    arm->targets[joint] = position;
+    reserve(arm, 1);
+
+    int ret = send_target(arm, joint, position, arm->inFlightLimit > 0);
+
+    // A failed command may mean the link was re-established with new handles
+    if (ret != simx_return_ok) {
+        int connectionID = arm->connectionID;
+        if (arm_refresh_handles(arm) == 0 && arm->connectionID != connectionID) {
+            ret = send_target(arm, joint, position, arm->inFlightLimit > 0);
+        }
+    }
+    trace_sample(arm);
+    return ret;
+}
+
+/**
+ * Joints of mask that are already within tolerance of their target: settled
+ * there, or (in a converging wait) never commanded and streamed there
+ */
+static int joints_on_target(NiryoArm* arm, const float* targets, int mask) {
+    float position;
+    long long start;
+    int j, on = 0;
+
+    for (j = 0; j < arm->jointCount; j++) {
+        if (!(mask & JOINT_MASK(j))) {
+            continue;
+        }
+        if ((arm->commandedMask & JOINT_MASK(j)) && fabsf(arm->targets[j] - targets[j]) > arm->tolerance) {
+            continue;
+        }
+        if (!(arm->settledMask & JOINT_MASK(j))) {
+            // Only the streamed buffer is read, so this costs no round trip
+            if ((arm->commandedMask & JOINT_MASK(j)) || arm->waitMode != WAIT_CONVERGE
+                || arm->clock.mode == CLOCK_VIRTUAL) {
+                continue;
+            }
+            start = clock_now_ms(&arm->clock);
+            if (Link::read_position(arm->clientID, arm->handles[j], &position) != simx_return_ok) {
+                count_call(arm, CALL_GET_POSITION, start);
+                continue;
+            }
+            count_call(arm, CALL_GET_POSITION, start);
+            arm->measured[j] = position;
+        }
+        if (fabsf(arm->measured[j] - targets[j]) <= arm->tolerance) {
+            on |= JOINT_MASK(j);
+        }
+    }
+    return on;
+}
+
+int arm_move_pose(NiryoArm* arm, const float* targets, int mask, int timeout_ms) {
+    long long start = clock_now_ms(&arm->clock), sent;
+    int j, count = 0, failed = 0, ret;
+
+    if (arm_link_lost(arm)) {
+        return ARM_LINK_LOST;
+    }
+
+    // Commands to joints already there would only cost a round trip and a wait
+    if (arm->elide) {
+        int on = joints_on_target(arm, targets, mask);
+
+        for (j = 0; j < arm->jointCount; j++) {
+            if (on & JOINT_MASK(j)) {
+                arm->stats.elidedCommands++;
+            }
+        }
+        mask &= ~on;
+        if (mask == 0) {
+            // Still a move of its phase (a press the approach already made counts as a press)
+            arm->stats.elidedMoves++;
+            arm->stats.elidedMs += timeout_ms;
+            hist_record(&arm->stats.phases[arm->phase], clock_now_ms(&arm->clock) - start);
+            return 0;
+        }
+    }
+
+    // The window is drained before pausing: a round trip cannot complete while paused
+    for (j = 0; j < arm->jointCount; j++) {
+        if (mask & JOINT_MASK(j)) {
+            count++;
+        }
+    }
+    reserve(arm, count);
+
+    // Queue every target while paused so they leave in the same message
+    sent = clock_now_ms(&arm->clock);
+    Link::pause(arm->clientID, 1);
+    count_call(arm, CALL_PAUSE, sent);
+    for (j = 0; j < arm->jointCount; j++) {
+        if (mask & JOINT_MASK(j)) {
+            arm->targets[j] = targets[j];
+            if (send_target(arm, j, targets[j], 1) != simx_return_ok) {
+                failed = 1;
+            }
+        }
+    }
+    sent = clock_now_ms(&arm->clock);
+    Link::pause(arm->clientID, 0);
+    count_call(arm, CALL_PAUSE, sent);
+
+    if (failed) {
+        if (arm_link_lost(arm)) {
+            return ARM_LINK_LOST;
+        }
+        printf("ERROR: Could not send pose to the arm\n");
+        return -1;
+    }
+    trace_sample(arm);
+    ret = arm_wait_reached(arm, mask, timeout_ms);
+    hist_record(&arm->stats.phases[arm->phase], clock_now_ms(&arm->clock) - start);
+    return ret;
+}
+
+int arm_move_planned(NiryoArm* arm, const float* targets, int mask) {
+    return arm_move_pose(arm, targets, mask, plan_duration_ms(arm->targets, targets, mask, &NIRYO_ONE_LIMITS));
+}
+
+int arm_press(NiryoArm* arm, int key, const float* targets, int mask, int timeout_ms) {
+    float hover[MAX_JOINTS], pose[MAX_JOINTS];
+    int attempt, presses, pressed, ret, j, lifted = 0;
+
+    // Nothing moves during a dry run, so nothing can register either
+    if (!arm->detectPress || arm->pressBaseline < 0 || arm->clock.mode == CLOCK_VIRTUAL) {
+        return arm_move_pose(arm, targets, mask, timeout_ms);
+    }
+
+    // Without a hover table the press is made again from where it started
+    memcpy(hover, arm->keyHover != NULL ? arm->keyHover[key] : arm->targets, sizeof(hover));
+    for (attempt = 0; ; attempt++) {
+        // A press the approach already made on this key counts; contacts on
+        // other keys on the way there are not the press
+        if (read_press(arm, &presses, &pressed) == 0 && presses > arm->pressBaseline && pressed != key) {
+            arm->pressBaseline = presses;
+        }
+
+        arm->pressWatch = key;
+        if (attempt == 0) {
+            ret = arm_move_pose(arm, targets, mask, timeout_ms);
+            memcpy(pose, arm->targets, sizeof(pose));
+            for (j = 0; j < arm->jointCount; j++) {
+                if (hover[j] != pose[j]) {
+                    lifted |= JOINT_MASK(j);
+                }
+            }
+        } else {
+            // Back down the way the key is approached: the joints that lifted
+            // the tool first, then the press joints alone
+            ret = (lifted & ~mask) != 0 ? arm_move_planned(arm, pose, lifted & ~mask) : 0;
+            if (ret != ARM_LINK_LOST) {
+                ret = arm_move_planned(arm, pose, mask);
+            }
+        }
+        arm->pressWatch = NO_KEY;
+        if (ret == ARM_LINK_LOST) {
+            return ret;
+        }
+
+        if (read_press(arm, &presses, &pressed) == 0 && presses > arm->pressBaseline) {
+            arm->pressBaseline = presses;
+            if (pressed != key) {
+                arm->stats.wrongPresses++;
+                printf("ERROR: Arm [%d] pressing key %d registered key %d\n", arm->instance, key, pressed);
+                return ARM_PRESS_FAILED;
+            }
+            arm->stats.pressesSeen++;
+            return 0;
+        }
+        if (attempt == PRESS_RETRIES) {
+            arm->stats.pressMisses++;
+            printf("ERROR: Arm [%d] pressed key %d %d times without the keypad registering it\n",
+                   arm->instance, key, attempt + 1);
+            return ARM_PRESS_FAILED;
+        }
+
+        // Lift straight off the key to its hover pose: only the joints that
+        // differ from it move, so the tool does not cross the neighbouring keys
+        arm->stats.pressRetries++;
+        if (lifted != 0 && arm_move_planned(arm, hover, lifted) == ARM_LINK_LOST) {
+            return ARM_LINK_LOST;
+        }
+    }
+}
+
+int arm_press_planned(NiryoArm* arm, int key, const float* targets, int mask) {
+    return arm_press(arm, key, targets, mask, plan_duration_ms(arm->targets, targets, mask, &NIRYO_ONE_LIMITS));
+}
+
+int arm_wait_reached(NiryoArm* arm, int mask, int timeout_ms) {
+    float position;
+    float actual[MAX_JOINTS];
+    long long start, polled;
+    int j, reached, ret, waited;
+    int tracing = arm->trace.fd != -1;
+
+    if (arm->waitMode == WAIT_FIXED || arm->clock.mode == CLOCK_VIRTUAL) {
+        if (!tracing && arm->pressWatch == NO_KEY) {
+            clock_sleep_ms(&arm->clock, timeout_ms);
+        } else {
+            // Sleep in polling slices so the trace shows the joints on their way
+            // and a watched press ends the dwell
+            for (waited = 0; waited < timeout_ms; waited += WAIT_POLL_MS) {
+                clock_sleep_ms(&arm->clock, timeout_ms - waited < WAIT_POLL_MS ? timeout_ms - waited : WAIT_POLL_MS);
+                trace_sample(arm);
+                if (arm->pressWatch != NO_KEY && press_registered(arm)) {
+                    return arm_link_lost(arm) ? ARM_LINK_LOST : 0;
+                }
+            }
+        }
+        if (arm_link_lost(arm)) {
+            return ARM_LINK_LOST;
+        }
+
+        // The full dwell is taken as the joints having arrived
+        for (j = 0; j < arm->jointCount; j++) {
+            if (mask & JOINT_MASK(j)) {
+                arm->measured[j] = arm->targets[j];
+            }
+        }
+        arm->settledMask |= mask & arm->commandedMask;
+        return 0;
+    }
+
+    start = clock_now_ms(&arm->clock);
+    for (;;) {
+        // Buffered positions keep their last value once the link is gone
+        if (arm_link_lost(arm)) {
+            return ARM_LINK_LOST;
+        }
+
+        // Joints outside the mask are only read for the trace
+        reached = 1;
+        for (j = 0; j < arm->jointCount && (reached || tracing); j++) {
+            actual[j] = NAN;
+            if (!(mask & JOINT_MASK(j)) && !tracing) {
+                continue;
+            }
+            polled = clock_now_ms(&arm->clock);
+            ret = Link::read_position(arm->clientID, arm->handles[j], &position);
+            count_call(arm, CALL_GET_POSITION, polled);
+            if (ret == simx_return_ok) {
+                actual[j] = position;
+            }
+            if ((mask & JOINT_MASK(j)) && (ret != simx_return_ok || fabsf(position - arm->targets[j]) > arm->tolerance)) {
+                reached = 0;
+            }
+        }
+        if (tracing) {
+            record_sample(arm, actual);
+        }
+        if (reached || (arm->pressWatch != NO_KEY && press_registered(arm))) {
+            // The joints moved to their targets (or onto the key), so those commands arrived
+            acknowledge(arm, mask);
+            if (reached) {
+                for (j = 0; j < arm->jointCount; j++) {
+                    if (mask & JOINT_MASK(j)) {
+                        arm->measured[j] = actual[j];
+                    }
+                }
+                arm->settledMask |= mask & arm->commandedMask;
+            }
+            return 0;
+        }
+        if (clock_now_ms(&arm->clock) - start >= timeout_ms) {
+            return -1;
+        }
+        // In sync mode this is one simulation step
+        clock_sleep_ms(&arm->clock, WAIT_POLL_MS);
+    }
+}
+
+int arm_sync_commands(NiryoArm* arm) {
+    long long start;
+    int ret;
+
+    if (arm->inFlight == 0) {
+        return 0;
+    }
+    start = clock_now_ms(&arm->clock);
+    ret = Link::ping(arm->clientID);
+    count_call(arm, CALL_PING, start);
+    if (ret != simx_return_ok && arm_link_lost(arm)) {
+        // These commands are sent again once the link is back (arm_recover())
+        return ARM_LINK_LOST;
+    }
+    if (ret != simx_return_ok) {
+        printf("ERROR: Commands #%ld..#%ld were not acknowledged (code 0x%x)\n",
+               arm->pending[0].seq, arm->pending[arm->inFlight - 1].seq, ret);
+        arm->commandErrors += arm->inFlight;
+        arm->inFlight = 0;
+        return -1;
+    }
+    acknowledge(arm, ALL_JOINTS);
+    return 0;
+}
+
+int arm_link_lost(NiryoArm* arm) {
+    return Link::connection_id(arm->clientID) == -1;
+}
+
+/**
+ * Close the lost connection and open a new one, waiting longer after each
+ * failed attempt
+ * @param attempts: Attempts made so far in this recovery, updated
+ * @param delayMs: Wait before the next attempt, updated
+ * @return: 0 once connected with the handles resolved, -1 when out of attempts
+ */
+static int reconnect(NiryoArm* arm, int* attempts, int* delayMs) {
+    long long start;
+
+    clock_stop(&arm->clock);
+    Link::disconnect(arm->clientID);
+    arm->clientID = -1;
+
+    while (arm->clientID == -1) {
+        if (*attempts >= arm->reconnects) {
+            printf("ERROR: Arm [%d] could not reconnect to %s:%d after %d attempt(s)\n",
+                   arm->instance, arm->host, arm->port, *attempts);
+            return -1;
+        }
+        (*attempts)++;
+        printf("Arm [%d] lost its link, reconnecting in %d ms (attempt %d/%d)...\n",
+               arm->instance, *delayMs, *attempts, arm->reconnects);
+
+        // The scene is not reachable, so the backoff is wall time whatever the clock
+        Link::sleep_ms(*delayMs);
+        *delayMs = *delayMs * 2 < RECONNECT_MAX_MS ? *delayMs * 2 : RECONNECT_MAX_MS;
+
+        start = clock_now_ms(&arm->clock);
+        arm->clientID = Link::connect(arm->host, arm->port);
+        count_call(arm, CALL_START, start);
+        if (arm->clientID != -1 && (clock_start(&arm->clock, arm->clientID) == -1 || arm_resolve_handles(arm) == -1)) {
+            clock_stop(&arm->clock);
+            Link::disconnect(arm->clientID);
+            arm->clientID = -1;
+        }
+    }
+    return 0;
+}
+
+int arm_recover(NiryoArm* arm, const float* pose) {
+    long long lostAt = clock_now_ms(&arm->clock), start;
+    float position;
+    int attempts = 0, delayMs = RECONNECT_FIRST_MS;
+    int j, ret, mask, moved;
+
+    // Replies of the commands sent before the drop will never arrive
+    arm->inFlight = 0;
+    memset(arm->lastCommand, 0, sizeof(arm->lastCommand));
+
+    do {
+        if (reconnect(arm, &attempts, &delayMs) == -1) {
+            return -1;
+        }
+
+        // A joint is known only if it is on pose and was last commanded there;
+        // the others are planned from where they are and sent back to the pose
+        mask = 0;
+        moved = 0;
+        for (j = 0; j < arm->jointCount; j++) {
+            start = clock_now_ms(&arm->clock);
+            ret = Link::query_position(arm->clientID, arm->handles[j], &position);
+            count_call(arm, CALL_GET_POSITION, start);
+            if (ret != simx_return_ok || arm->targets[j] != pose[j] || fabsf(position - pose[j]) > arm->tolerance) {
+                mask |= JOINT_MASK(j);
+                moved++;
+                arm->targets[j] = (ret == simx_return_ok) ? position : pose[j];
+            }
+        }
+        ret = (mask != 0) ? arm_move_planned(arm, pose, mask) : 0;
+    } while (ret == ARM_LINK_LOST);
+
+    hist_record(&arm->stats.outages, clock_now_ms(&arm->clock) - lostAt);
+    printf("Arm [%d] reconnected after %d attempt(s), %d joint(s) moved back to the resume pose\n",
+           arm->instance, attempts, moved);
+    return 0;
+}
+
+void arm_disconnect(NiryoArm* arm) {
+    long long start;
+
+    if (arm->clientID != -1 && !arm_link_lost(arm)) {
+        arm_sync_commands(arm);
+    }
+    trace_close(&arm->trace);
+    clock_stop(&arm->clock);
+
+    // Finishing client -1 would close every connection of the process, including other arms
+    if (arm->clientID != -1) {
+        start = clock_now_ms(&arm->clock);
+        Link::disconnect(arm->clientID);
+        count_call(arm, CALL_FINISH, start);
+    }
+    arm->clientID = -1;
+}
+
+void (*arm_mark_observer)(const NiryoArm* arm, int key) = NULL;
+void (*arm_ballot_observer)(const NiryoArm* arm, int cast) = NULL;
+
+// Number of report requests received by signal
+static volatile sig_atomic_t reportRequests = 0;
+
+static void request_report(int signum) {
+    (void)signum;
+    reportRequests++;
+}
+
+void arm_report_on_signal(int signum) {
+    signal(signum, request_report);
+}
+
+void arm_mark(NiryoArm* arm, int key) {
+    ArmStats* stats = &arm->stats;
+    long long now = clock_now_ms(&arm->clock);
+    char title[48];
+
+    // The previous key ends where this mark starts, and a confirm ends its ballot
+    // (unless the confirm is started over after a lost link)
+    if (stats->markKey != NO_KEY) {
+        hist_record(&stats->keys[stats->markKey], now - stats->markMs);
+        if (stats->markKey == KEY_CONFIRM && key != KEY_CONFIRM && stats->ballotStartMs >= 0) {
+            hist_record(&stats->ballots, now - stats->ballotStartMs);
+            stats->ballotStartMs = -1;
+            if (arm_ballot_observer != NULL) {
+                arm_ballot_observer(arm, 1);
+            }
+        }
+    }
+    if (key != NO_KEY && stats->ballotStartMs < 0) {
+        stats->ballotStartMs = now;
+    }
+    stats->markKey = key;
+    stats->markMs = now;
+    arm->phase = (key == NO_KEY) ? PHASE_HOME : (key == KEY_CONFIRM) ? PHASE_CONFIRM : PHASE_APPROACH;
+
+    // Presses counted from here on belong to this key
+    if (arm->detectPress && arm->clientID != -1) {
+        int pressed;
+        if (read_press(arm, &arm->pressBaseline, &pressed) == -1) {
+            arm->pressBaseline = -1;
+        }
+    }
+
+    if (stats->reportsSeen != reportRequests) {
+        stats->reportsSeen = reportRequests;
+        snprintf(title, sizeof(title), "Arm [%d] latency so far (ms)", arm->instance);
+        arm_print_stats(stats, title);
+    }
+
+    if (arm_mark_observer != NULL) {
+        arm_mark_observer(arm, key);
+    }
+}
+
+void arm_abort_ballot(NiryoArm* arm) {
+    ArmStats* stats = &arm->stats;
+
+    stats->failedBallots++;
+    stats->ballotStartMs = -1;
+    stats->markKey = NO_KEY;
+    printf("ERROR: Arm [%d] gave up the ballot, its confirm key was not pressed\n", arm->instance);
+    if (arm_ballot_observer != NULL) {
+        arm_ballot_observer(arm, 0);
+    }
+}
+
+void arm_print_stats(const ArmStats* stats, const char* title) {
+    static const char* PHASE_NAMES[PHASE_COUNT] = {"approach", "press", "retract", "confirm", "home"};
+    static const char* CALL_NAMES[CALL_COUNT] = {
+        "start", "get handle", "set target", "get position", "pause",
+        "ping", "synchronous", "trigger", "finish", "get signal"
+    };
+    char name[16];
+    int i;
+
+    printf("\n=== %s ===\n", title);
+    hist_print_header("Key");
+    for (i = 0; i < KEY_COUNT; i++) {
+        if (i == KEY_CONFIRM) {
+            snprintf(name, sizeof(name), "confirm");
+        } else {
+            snprintf(name, sizeof(name), "digit %d", i);
+        }
+        hist_print(name, &stats->keys[i]);
+    }
+    hist_print_header("Phase");
+    for (i = 0; i < PHASE_COUNT; i++) {
+        hist_print(PHASE_NAMES[i], &stats->phases[i]);
+    }
+    hist_print_header("Ballot");
+    hist_print("ballot", &stats->ballots);
+    hist_print_header("Remote call");
+    for (i = 0; i < CALL_COUNT; i++) {
+        hist_print(CALL_NAMES[i], &stats->calls[i]);
+    }
+    if (stats->outages.count > 0) {
+        hist_print_header("Link");
+        hist_print("outage", &stats->outages);
+    }
+    if (stats->pressesSeen + stats->pressRetries + stats->pressMisses + stats->wrongPresses > 0) {
+        printf("\nPress detection: %ld registered, %ld pressed again, %ld missed, %ld on the wrong key\n",
+               stats->pressesSeen, stats->pressRetries, stats->pressMisses, stats->wrongPresses);
+    }
+    if (stats->failedBallots > 0) {
+        printf("Failed ballots: %ld given up without their confirm\n", stats->failedBallots);
+    }
+    if (stats->elidedCommands > 0) {
+        printf("\nElided: %ld joint command(s) already on target, %ld move(s) and %lld ms of waits skipped\n",
+               stats->elidedCommands, stats->elidedMoves, stats->elidedMs);
+    }
+}
+
+void arm_merge_stats(ArmStats* into, const ArmStats* from) {
+    int i;
+
+    for (i = 0; i < KEY_COUNT; i++) {
+        hist_merge(&into->keys[i], &from->keys[i]);
+    }
+    for (i = 0; i < PHASE_COUNT; i++) {
+        hist_merge(&into->phases[i], &from->phases[i]);
+    }
+    hist_merge(&into->ballots, &from->ballots);
+    for (i = 0; i < CALL_COUNT; i++) {
+        hist_merge(&into->calls[i], &from->calls[i]);
+    }
+    hist_merge(&into->outages, &from->outages);
+    into->pressesSeen += from->pressesSeen;
+    into->pressRetries += from->pressRetries;
+    into->pressMisses += from->pressMisses;
+    into->wrongPresses += from->wrongPresses;
+    into->failedBallots += from->failedBallots;
+    into->elidedMoves += from->elidedMoves;
+    into->elidedCommands += from->elidedCommands;
+    into->elidedMs += from->elidedMs;
+}
@@ -0,0 +1,369 @@
+/*
+ * Niryo One Arm Session
+ *
+ * Session of one arm: the CoppeliaSim connection and joint handles, the
+ * moves and presses sent to it, and the stats of the keys and ballots it
+ * cast. The handles are resolved once right after connecting, so the motion
+ * functions only have to send the set-position command.
+ */
+
+#ifndef NIRYO_ARM_H
+#define NIRYO_ARM_H
+
+// CoppeliaSim remote API, or the backend chosen at compile time
+#include "transport.h"
+
+#include "niryo_clock.h"
+#include "joint_trace.h"
+
+// Joints driven on each scene and size of the per-joint arrays
+#define KEYPAD_JOINTS 3
+#define CHAIN_JOINTS 6
+#define MAX_JOINTS 6
+
+// Scene layouts the controllers know how to drive
+enum Scene {
+    SCENE_KEYPAD = 0,    // /base_link_respondable[n]/joint_1..joint_3 (niryo_controller.c, Main/main.c)
+    SCENE_CHAIN = 1      // /NiryoOne/Joint(/Link/Joint)... six joint chain (vrep.cc)
+};
+
+// Joint indexes used to address the handle array
+enum Joint {
+    JOINT_1 = 0,
+    JOINT_2 = 1,
+    JOINT_3 = 2,
+    JOINT_4 = 3,
+    JOINT_5 = 4,
+    JOINT_6 = 5
+};
+
+// Bit mask selecting joints for arm_wait_reached()
+#define JOINT_MASK(joint) (1 << (joint))
+#define ALL_JOINTS ((1 << MAX_JOINTS) - 1)
+#define KEYPAD_MASK ((1 << KEYPAD_JOINTS) - 1)
+
+// Keys of the voting panel: digits 0-9 plus the confirm button
+#define KEY_CONFIRM 10
+#define KEY_COUNT 11
+
+// No key pressed yet (the arm is at the reference point or at rest)
+#define NO_KEY -1
+
+// Default distance (radians) at which a joint counts as arrived
+#define DEFAULT_TOLERANCE 0.005f
+
+// Interval between position polls while waiting for a move to finish
+#define WAIT_POLL_MS 5
+
+// Upper bound and default for joint commands sent without waiting for their reply
+#define MAX_IN_FLIGHT 64
+#define DEFAULT_IN_FLIGHT 8
+
+// Returned by the motion functions when the link to the simulator is gone
+#define ARM_LINK_LOST -2
+
+// Returned by arm_press() when the keypad missed the key or registered another one
+#define ARM_PRESS_FAILED -3
+
+// Reconnection attempts after a lost link, and their backoff (milliseconds, doubled up to the maximum)
+#define DEFAULT_RECONNECTS 10
+#define RECONNECT_FIRST_MS 250
+#define RECONNECT_MAX_MS 8000
+
+// Default memory for compiled ballots kept for reuse (--ballot-cache, KiB)
+#define DEFAULT_BALLOT_CACHE_KB 1024
+
+// Extra attempts at a press the keypad did not register (--detect-press)
+#define PRESS_RETRIES 2
+
+// A joint command that has been sent but not acknowledged yet
+typedef struct {
+    long seq;                     // Command number, counted from 1 per session
+    int joint;                    // Joint index
+    float target;                 // Commanded position (radians)
+    long long issuedMs;           // Clock time the command was sent
+} ArmCommand;
+
+// What a move is for, as reported in the latency statistics
+enum ArmPhase {
+    PHASE_APPROACH = 0,  // Reaching a digit (including the move from the previous key)
+    PHASE_PRESS = 1,     // Pressing a digit
+    PHASE_RETRACT = 2,   // Lifting off a digit
+    PHASE_CONFIRM = 3,   // Every move of the confirm key
+    PHASE_HOME = 4,      // Between the rest pose and the keypad
+    PHASE_COUNT = 5
+};
+
+// Latency statistics of one session, in milliseconds of its clock
+typedef struct {
+    Histogram keys[KEY_COUNT];        // From the mark of a key to the next mark
+    Histogram phases[PHASE_COUNT];    // Each arm_move_pose(), by the phase it belongs to
+    Histogram ballots;                // From the first key of a ballot to the end of its confirm key
+    Histogram calls[CALL_COUNT];      // Remote calls by RemoteCall, with the time they blocked
+    Histogram outages;                // From a lost link to the arm being back on its resume pose
+    long pressesSeen;                 // Presses the keypad registered (--detect-press)
+    long pressRetries;                // Presses made again because the first one did not register
+    long pressMisses;                 // Keys given up after PRESS_RETRIES unregistered presses
+    long wrongPresses;                // Presses registered on another key
+    long failedBallots;               // Ballots given up unconfirmed after a failed press (arm_abort_ballot())
+    long elidedMoves;                 // Moves dropped because every joint was already on its target
+    long elidedCommands;              // Joint commands dropped for the same reason
+    long long elidedMs;               // Waits of the dropped moves
+    int markKey;                      // Key being worked on (NO_KEY at rest)
+    long long markMs;                 // Clock time of the last mark
+    long long ballotStartMs;          // Clock time the open ballot started (-1: none open)
+    int reportsSeen;                  // Report requests (signals) this session already answered
+} ArmStats;
+
+// How the controllers wait for a commanded move
+enum WaitMode {
+    WAIT_FIXED = 0,      // Sleep the full dwell time (legacy behaviour)
+    WAIT_CONVERGE = 1    // Return as soon as the joints are within tolerance
+};
+
+// Connection and handles of one arm in the scene
+typedef struct {
+    int clientID;                 // Remote API client id (-1 when disconnected)
+    const char* host;             // Simulator address and port (--host, --port; the ones connected to, used to reconnect)
+    int port;
+    int connectionID;             // Connection id the handles were resolved for
+    int scene;                    // SCENE_KEYPAD or SCENE_CHAIN
+    int jointCount;               // Joints driven on this scene
+    int instance;                 // Arm index in the scene, the [0] in /base_link_respondable[0]
+    int handles[MAX_JOINTS];      // Object handles indexed by Joint
+    float targets[MAX_JOINTS];    // Last commanded position of each joint
+    int waitMode;                 // WAIT_FIXED or WAIT_CONVERGE
+    float tolerance;              // Arrival tolerance in radians for WAIT_CONVERGE
+    NiryoClock clock;             // Paces every wait (real time, synchronous steps or virtual)
+    const char* compileTo;        // --compile: motion program file to write instead of running (NULL if unused)
+    const char* programFrom;      // --program: precompiled motion program to run (NULL if unused)
+    const char* layoutFrom;       // --layout: key layout file to use instead of the built-in one (NULL if unused)
+    const char* traceTo;          // --trace: joint trace file to record while connected (NULL if unused)
+    const char* journalTo;        // --journal: journal of cast ballots, skipped on a restart (NULL if unused)
+    int arms;                     // --arms: arms of the scene sharing the ballots (1 = this arm only)
+    int inFlightLimit;            // --in-flight: commands allowed without a reply (0 = wait for every reply)
+    int reconnects;               // --reconnect: attempts to get a lost link back (0 = give up at once)
+    int ballotCacheKb;            // --ballot-cache: KiB of compiled ballots kept for reuse (0 = off)
+    int detectPress;              // --detect-press: end presses on the keypad contact signal and check them
+    int pressWatch;               // Key whose press ends the move being waited for (NO_KEY: none)
+    int pressBaseline;            // Presses counted by the keypad when the current key started (-1: unknown)
+    const float (*keyHover)[MAX_JOINTS];  // Hover pose of each key, a missed press is made again from (NULL: none)
+    int resyncPending;            // 1 after a given-up ballot: the next step sends every joint (program_run())
+    float resyncPose[MAX_JOINTS]; // Pose the skipped steps would have left the arm on
+    int elide;                    // Drop commands to joints already on their target (--no-elide clears it)
+    int commandedMask;            // Joints commanded since the handles were resolved
+    int settledMask;              // Joints seen on (or waited onto) their commanded target since
+    float measured[MAX_JOINTS];   // Position of each settled joint when it was last seen
+    int inFlight;                 // Commands in pending[] awaiting acknowledgement
+    ArmCommand pending[MAX_IN_FLIGHT];
+    ArmCommand lastCommand[MAX_JOINTS];   // Last command of each joint, owner of its next reply
+    long commandsSent;            // Joint commands sent in this session
+    long commandErrors;           // Commands reported as failed
+    long long maxAckMs;           // Longest time a command waited for its acknowledgement
+    int phase;                    // ArmPhase of the moves being sent (set by arm_mark() and the callers)
+    ArmStats stats;
+    JointTrace trace;             // Commanded and streamed positions (recording only with --trace)
+} NiryoArm;
+
+/**
+ * Fill a session with default settings (converging waits, default tolerance, real-time clock)
+ * @param scene: SCENE_KEYPAD or SCENE_CHAIN
+ */
+void arm_init(NiryoArm* arm, int scene);
+
+/**
+ * Parse the shared command line into the session:
+ *   --fixed-dwell       sleep the full calibrated dwell after every move
+ *   --tolerance <rad>   arrival tolerance used when waiting for convergence
+ *   --clock <mode>      real (default), sync (step the scene in synchronous
+ *                       mode) or virtual (dry run, no waiting)
+ *   --step-ms <ms>      scene time step used by the sync clock
+ *   --compile <file>    compile the ballots into a motion program and exit
+ *   --program <file>    run a compiled motion program instead of a voting file
+ *   --arms <n>          drive arms [0]..[n-1] in parallel (arm i on port --port + i; niryo_controller)
+ *   --in-flight <n>     joint commands sent ahead of their replies (default 8, 0 = wait for each reply)
+ *   --layout <file>     key layout to use instead of the built-in one (e.g. written by calibration_tuner)
+ *   --trace <file>      record commanded and actual joint positions (joint_trace.h)
+ *   --reconnect <n>     attempts to reconnect after the link drops (default 10, 0 = stop)
+ *   --journal <file>    record cast ballots and skip those already recorded (ballot_journal.h)
+ *   --ballot-cache <KiB> memory for compiled ballots reused by repeated ones (ballot_cache.h, 0 = off)
+ *   --detect-press      end each press when the keypad registers it, and press again if it did not
+ *   --no-elide          send moves to joints already on their target
+ *   --host <address>    simulator address (default 127.0.0.1)
+ *   --port <n>          remote API port (default 19999; arm i of --arms uses port + i)
+ *   --backend <name>    transport the binary must be built for: remote, sim or replay (transport.h)
+ *   --record <file>     write every remote call to a call log (call_log.h)
+ *   --replay <file>     answer the remote calls from a call log (replay builds only)
+ *   --replay-speed <s>  fast (default: no waiting) or recorded (sleeps and round trips take their time)
+ *   <file>              voting file to read (optional)
+ * @param input: Receives the voting file name; left unchanged when none is given
+ * @return: 0 on success, -1 on an unknown or incomplete option
+ */
+int arm_parse_options(NiryoArm* arm, int argc, char* argv[], const char** input);
+
+/**
+ * Connect to CoppeliaSim and resolve the joint handles of the arm, and
+ * start the joint trace if one was asked for (arm [i] of several writes
+ * to "<file>.<i>")
+ * @param arm: Session to fill
+ * @param host: Simulator address (e.g. "127.0.0.1")
+ * @param port: Remote API port (e.g. 19999)
+ * @param instance: Arm index in the scene
+ * @return: 0 on success, -1 on failure
+ */
+int arm_connect(NiryoArm* arm, const char* host, int port, int instance);
+
+/**
+ * Look up every joint of the scene once and store them in arm->handles
+ * @return: 0 on success, -1 if any handle could not be resolved
+ */
+int arm_resolve_handles(NiryoArm* arm);
+
+/**
+ * Re-resolve the handles if the remote API reports a new connection
+ * @return: 0 if the handles are valid, -1 otherwise
+ */
+int arm_refresh_handles(NiryoArm* arm);
+
+/**
+ * Send a target position to one joint using the cached handle.
+ * With arm->inFlightLimit > 0 the command is sent with simx_opmode_oneshot
+ * and tracked in arm->pending until it is acknowledged; a full window is
+ * first drained with arm_sync_commands().
+ * @param joint: Joint index (JOINT_1..JOINT_6)
+ * @param position: Target position in radians
+ * @return: simx_return_ok if the command was sent, otherwise the error flags
+ */
+int arm_set_joint(NiryoArm* arm, int joint, float position);
+
+/**
+ * Move several joints together: all targets go out in one packet by pausing
+ * the communication thread while they are queued, then the call waits for
+ * the joints to arrive. Phases that need a strict joint order for clearance
+ * should use arm_set_joint() + arm_wait_reached() one joint at a time instead.
+ * Joints already settled within arm->tolerance of their target are left out,
+ * and a move left with no joint returns at once, counting its timeout as
+ * elided in the statistics.
+ * @param targets: Target positions indexed by Joint (only masked joints are read)
+ * @param mask: Joints to move (JOINT_MASK(...) combination)
+ * @param timeout_ms: Maximum time to wait for the pose in milliseconds
+ * @return: 0 if the pose was reached, -1 on send error or timeout, ARM_LINK_LOST if the link dropped
+ */
+int arm_move_pose(NiryoArm* arm, const float* targets, int mask, int timeout_ms);
+
+/**
+ * arm_move_pose() with the time limit planned from the last commanded pose
+ * under the Niryo One velocity and acceleration limits (trajectory.h)
+ */
+int arm_move_planned(NiryoArm* arm, const float* targets, int mask);
+
+/**
+ * Press a key: arm_move_pose() that ends as soon as the keypad signal
+ * (keypadPress[n], or chainPress on the chain scene) reports a press since
+ * the key was marked (contacts with other keys on the way are ignored, the
+ * press itself must land on key). If the move ends without one, the arm
+ * lifts straight off the key to its hover pose (arm->keyHover, or where the
+ * press started without one), comes back down with the joints that lifted
+ * it, then presses again with the masked joints alone, up to PRESS_RETRIES
+ * times.
+ * Without --detect-press, on a virtual clock or before the signal has a
+ * value, this is a plain arm_move_pose().
+ * @param key: Key being pressed (0-9 or KEY_CONFIRM), checked against the one registered
+ * @return: 0 if the key registered (or the pose was reached without detection),
+ *          ARM_PRESS_FAILED on a miss or a wrong key, -1 if the move failed without
+ *          detection, ARM_LINK_LOST if the link dropped
+ */
+int arm_press(NiryoArm* arm, int key, const float* targets, int mask, int timeout_ms);
+
+/**
+ * arm_press() with the time limit planned like arm_move_planned()
+ */
+int arm_press_planned(NiryoArm* arm, int key, const float* targets, int mask);
+
+/**
+ * Wait until the selected joints reach their last commanded target.
+ * In WAIT_CONVERGE mode the streamed joint positions are polled and the call
+ * returns as soon as every joint is within arm->tolerance; timeout_ms is only
+ * the upper bound. In WAIT_FIXED mode it simply sleeps timeout_ms, and so does
+ * a virtual clock, since nothing moves during a dry run. While a press is
+ * watched (arm_press()) the wait also ends once the keypad registers it.
+ * @param mask: Joints to wait for (JOINT_MASK(...) combination)
+ * @param timeout_ms: Maximum time to wait in milliseconds
+ * @return: 0 if the joints arrived, -1 on timeout, ARM_LINK_LOST if the link dropped
+ */
+int arm_wait_reached(NiryoArm* arm, int mask, int timeout_ms);
+
+/**
+ * Wait for the replies of every command in flight (one blocking round trip:
+ * the server handles commands in order, so its reply to a ping means all
+ * earlier commands were received). Joints found within tolerance by
+ * arm_wait_reached() acknowledge their commands without this call. A remote
+ * error is reported with the command it belongs to once the next reply for
+ * that joint arrives, i.e. when the joint is commanded again.
+ * @return: 0 if the commands were acknowledged, -1 if the round trip failed, ARM_LINK_LOST if the link dropped
+ */
+int arm_sync_commands(NiryoArm* arm);
+
+/**
+ * Check whether the link to the simulator is gone (local, no round trip)
+ */
+int arm_link_lost(NiryoArm* arm);
+
+/**
+ * Get a lost link back and put the arm on a known pose: reconnect with
+ * doubling backoff (arm->reconnects attempts), resolve the handles again,
+ * read where every joint is and move only the joints that are not already
+ * on pose. The commands that were in flight are dropped.
+ * @param pose: Pose to resume from, indexed by Joint (e.g. where the interrupted key started)
+ * @return: 0 once the arm is on pose, -1 if the link could not be restored
+ */
+int arm_recover(NiryoArm* arm, const float* pose);
+
+/**
+ * Close the connection to CoppeliaSim (after acknowledging the commands in flight)
+ */
+void arm_disconnect(NiryoArm* arm);
+
+// Optional observer of key boundaries (used by the benchmark); NULL when unused.
+// With several arms it is called from each arm's thread.
+extern void (*arm_mark_observer)(const NiryoArm* arm, int key);
+
+// Optional observer of finished ballots, called by arm_mark() once the moves
+// of a confirm key are done (cast = 1), or by arm_abort_ballot() (cast = 0);
+// used to journal ballots run from a compiled program
+extern void (*arm_ballot_observer)(const NiryoArm* arm, int cast);
+
+/**
+ * Report that the arm starts working on a key (0-9, or 10 for confirm),
+ * or -1 when it leaves the keypad for the home position. Closes the
+ * latency of the previous key (and of the ballot after a confirm), sets
+ * arm->phase to the approach, confirm or home phase, reads the press count
+ * of the keypad with --detect-press, and prints the report if one was
+ * requested by signal since the last key.
+ */
+void arm_mark(NiryoArm* arm, int key);
+
+/**
+ * Give up the open ballot after a failed press: it is counted as failed,
+ * its confirm must not be pressed and it is not reported as cast. The key
+ * being worked on is closed without a latency.
+ */
+void arm_abort_ballot(NiryoArm* arm);
+
+/**
+ * Print the latency distributions per key, per phase and per ballot, and
+ * the remote calls made
+ */
+void arm_print_stats(const ArmStats* stats, const char* title);
+
+/**
+ * Add the statistics of one session to another (totals of several arms)
+ */
+void arm_merge_stats(ArmStats* into, const ArmStats* from);
+
+/**
+ * Make a signal (e.g. SIGUSR1) print every arm's report at its next key
+ */
+void arm_report_on_signal(int signum);
+
+#endif
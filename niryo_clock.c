@@ -0,0 +1,106 @@
+/*
+ * Controller Clock
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "niryo_clock.h"
+
+#include "transport.h"
+
+void clock_init(NiryoClock* clock, int mode, int stepMs) {
+    clock->mode = mode;
+    clock->clientID = -1;
+    clock->stepMs = stepMs > 0 ? stepMs : DEFAULT_STEP_MS;
+    clock->nowMs = 0;
+    clock->calls = NULL;
+}
+
+/**
+ * Record a remote call made by the clock and how long it blocked on the clock
+ */
+static void count_call(NiryoClock* clock, int call, long long startMs) {
+    if (clock->calls != NULL) {
+        hist_record(&clock->calls[call], clock_now_ms(clock) - startMs);
+    }
+}
+
+int clock_mode_from_name(const char* name) {
+    if (strcmp(name, "real") == 0) {
+        return CLOCK_REAL;
+    }
+    if (strcmp(name, "sync") == 0) {
+        return CLOCK_SYNC;
+    }
+    if (strcmp(name, "virtual") == 0) {
+        return CLOCK_VIRTUAL;
+    }
+    return -1;
+}
+
+int clock_start(NiryoClock* clock, int clientID) {
+    long long start = clock_now_ms(clock);
+    int ret;
+
+    clock->clientID = clientID;
+    if (clock->mode == CLOCK_SYNC) {
+        ret = Link::synchronous(clientID, 1);
+        count_call(clock, CALL_SYNCHRONOUS, start);
+        if (ret != simx_return_ok) {
+            printf("ERROR: Could not enable synchronous mode\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void clock_stop(NiryoClock* clock) {
+    long long start = clock_now_ms(clock);
+
+    if (clock->mode == CLOCK_SYNC && clock->clientID != -1) {
+        Link::synchronous(clock->clientID, 0);
+        count_call(clock, CALL_SYNCHRONOUS, start);
+    }
+    clock->clientID = -1;
+}
+
+long long clock_now_ms(NiryoClock* clock) {
+    if (clock->mode == CLOCK_REAL) {
+        return Link::now_ms();
+    }
+    return clock->nowMs;
+}
+
+void clock_sleep_ms(NiryoClock* clock, int ms) {
+    long long start;
+    int steps;
+
+    if (ms <= 0) {
+        return;
+    }
+
+    switch (clock->mode) {
+        case CLOCK_REAL:
+            Link::sleep_ms(ms);
+            break;
+
+        case CLOCK_SYNC:
+            // Advance whole steps; the ping returns once the last step was computed
+            steps = (ms + clock->stepMs - 1) / clock->stepMs;
+            while (steps-- > 0) {
+                start = clock_now_ms(clock);
+                Link::trigger(clock->clientID);
+                count_call(clock, CALL_TRIGGER, start);
+                clock->nowMs += clock->stepMs;
+            }
+            start = clock_now_ms(clock);
+            Link::ping(clock->clientID);
+            count_call(clock, CALL_PING, start);
+            break;
+
+        default:
+            clock->nowMs += ms;
+            break;
+    }
+}
@@ -0,0 +1,82 @@
+/*
+ * Controller Clock
+ *
+ * Every wait of the controllers goes through this clock, so the same binary
+ * can pace itself in three ways chosen at startup:
+ *   CLOCK_REAL     real time, the scene runs freely (sleeps of the transport, transport.h)
+ *   CLOCK_SYNC     CoppeliaSim synchronous mode: each wait triggers as many
+ *                  simulation steps as it covers, as fast as the physics
+ *                  engine can compute them
+ *   CLOCK_VIRTUAL  dry run: time is only counted, nothing waits
+ */
+
+#ifndef NIRYO_CLOCK_H
+#define NIRYO_CLOCK_H
+
+#include "histogram.h"
+
+// Default simulation step of CoppeliaSim scenes (milliseconds)
+#define DEFAULT_STEP_MS 50
+
+enum ClockMode {
+    CLOCK_REAL = 0,
+    CLOCK_SYNC = 1,
+    CLOCK_VIRTUAL = 2
+};
+
+// Remote API calls counted by an arm session (the clock makes the synchronous mode ones)
+enum RemoteCall {
+    CALL_START = 0,          // simxStart
+    CALL_GET_HANDLE = 1,     // simxGetObjectHandle
+    CALL_SET_TARGET = 2,     // simxSetJointTargetPosition
+    CALL_GET_POSITION = 3,   // simxGetJointPosition
+    CALL_PAUSE = 4,          // simxPauseCommunication
+    CALL_PING = 5,           // simxGetPingTime
+    CALL_SYNCHRONOUS = 6,    // simxSynchronous
+    CALL_TRIGGER = 7,        // simxSynchronousTrigger
+    CALL_FINISH = 8,         // simxFinish
+    CALL_GET_SIGNAL = 9,     // simxGetIntegerSignal
+    CALL_COUNT = 10
+};
+
+typedef struct {
+    int mode;            // CLOCK_REAL, CLOCK_SYNC or CLOCK_VIRTUAL
+    int clientID;        // Connection used to trigger steps in CLOCK_SYNC
+    int stepMs;          // Scene time step for CLOCK_SYNC
+    long long nowMs;     // Elapsed time for CLOCK_SYNC and CLOCK_VIRTUAL
+    Histogram* calls;    // Remote call histograms indexed by RemoteCall (NULL: not recorded)
+} NiryoClock;
+
+/**
+ * Fill a clock with its mode (the connection is attached by clock_start)
+ */
+void clock_init(NiryoClock* clock, int mode, int stepMs);
+
+/**
+ * Parse "real", "sync" or "virtual"
+ * @return: The clock mode, or -1 if the name is unknown
+ */
+int clock_mode_from_name(const char* name);
+
+/**
+ * Attach the clock to a connection; enables synchronous mode for CLOCK_SYNC
+ * @return: 0 on success, -1 if synchronous mode could not be enabled
+ */
+int clock_start(NiryoClock* clock, int clientID);
+
+/**
+ * Leave synchronous mode so the scene runs freely again
+ */
+void clock_stop(NiryoClock* clock);
+
+/**
+ * Current time in milliseconds (only differences are meaningful)
+ */
+long long clock_now_ms(NiryoClock* clock);
+
+/**
+ * Let ms milliseconds of scene time pass
+ */
+void clock_sleep_ms(NiryoClock* clock, int ms);
+
+#endif
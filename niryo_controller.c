@@ -17,162 +17,246 @@
  * Date: 2025
  */
 
-#define PI 3.14
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Include CoppeliaSim remote API
-extern "C" {
-#include "extApi.h"
-}
+// Include CoppeliaSim remote API and the shared arm session
+#include "niryo_arm.h"
+#include "key_transitions.h"
+#include "ballot_reader.h"
+#include "motion_program.h"
+#include "key_layout.h"
+#include "ballot_journal.h"
+#include "ballot_cache.h"
+
+// Connection and joint handles of the arm
+NiryoArm arm;
+
+// Joint positions for each key (digits 0-9, then confirm), solved from the key layout at startup
+float numj3[KEY_COUNT], numj2[KEY_COUNT], numj1[KEY_COUNT], backj2[KEY_COUNT];
+
+// Reference point (above digit 5) the arm starts from
+float reference[KEYPAD_JOINTS];
+
+// Pose right above each key, where a missed press is made again from
+float hover[KEY_COUNT][MAX_JOINTS];
+
+// Press sequence of every key and the direct moves between them
+PoseTable table;
+
+// Ballots compiled so far, replayed when the same ballot comes again (shared by the arms)
+BallotCache cache;
+
+// One arm of the scene working through the shared ballot queue
+typedef struct {
+    NiryoArm arm;            // Session of this arm (options copied from the command line)
+    pthread_t thread;
+    int connected;           // 1 once the arm reached its reference point
+    long ballots;            // Ballots cast by this arm
+    long digits;             // Digits typed by this arm
+    long late;               // Moves that did not finish within their time limit
+    long failed;             // Ballots given up after a failed press
+    long long elapsedMs;     // Time from the reference point to the end of the return home
+} ArmWorker;
+
+// Ballot queue shared by the arms
+BallotReader queue;
+pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
 
-// Global variables for CoppeliaSim connection
-int clientID;
-int handler;
-simxChar handlerName[150];
+// Ballots already cast (--journal), and the compiled ones in program order until they are cast
+BallotJournal journal;
+JournalEntry* compiled = NULL;
+long compiledCount = 0;
+long compiledCapacity = 0;
+long castCount = 0;
 
 /**
- * Move the robotic arm to draw/select a specific digit
- * @param digit: The digit to select (0-9)
+ * Called once the confirm key of a compiled ballot is done (journal it), or
+ * once the ballot was given up (leave it out)
  */
-void move_digit(int digit) {
-    // Joint positions for each digit (0-9) - calibrated for optimal movement
-    float numj3[] = {-PI / 35, PI / 45, PI / 20, PI / 20, PI / 150, PI / 45, PI / 30, -PI / 55, 0, PI / 200};
-    float numj2[] = {-PI / 4, -PI / 4, -PI / 4, -PI / 4, -PI / 4.5, -PI / 4, -PI / 4, -PI / 4.5, -PI / 4, -PI / 4};
-    float numj1[] = {-PI / 11, -PI / 15, -PI / 11, -PI / 10, -PI / 15, -PI / 11, -PI / 9.5, -PI / 15, -PI / 11, -PI / 9.5};
-    float backj2[] = {-PI / 3.75, -PI / 3.8, -PI / 3.6, -PI / 3.55, -PI / 3.8, -PI / 3.70, -PI / 3.6, -PI / 3.9, -PI / 3.75, -PI / 3.65};
-
-    // Time delays for each movement phase (milliseconds)
-    int t1[] = {1000, 1000, 2000, 3000, 4000, 2000, 3000, 2000, 2000, 2000};
-    int t2[] = {1000, 3000, 2000, 1000, 5000, 1000, 5000, 2000, 2000, 3000};
-    int t3[] = {1000, 3000, 2000, 2000, 2000, 1000, 3000, 2000, 1000, 2000};
-    int t4[] = {1000, 3000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000};
-
-    printf("Moving to digit: %d\n", digit);
-
-    // Move joint 3 to position
-    strcpy(handlerName, "/base_link_respondable[0]/joint_3");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)numj3[digit], (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(t1[digit]);
-
-    // Move joint 2 to position
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)numj2[digit], (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(t2[digit]);
-
-    // Move joint 1 to position
-    strcpy(handlerName, "/base_link_respondable[0]/joint_1");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)numj1[digit], (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(t3[digit]);
-
-    // Return joint 2 to intermediate position
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)backj2[digit], (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(t4[digit]);
+void on_ballot_cast(const NiryoArm* session, int cast) {
+    (void)session;
+    if (castCount < compiledCount) {
+        if (cast) {
+            journal_append(&journal, &compiled[castCount]);
+        }
+        castCount++;
+    }
 }
 
 /**
- * Move the robotic arm to the initial/home position (all joints to zero)
+ * Solve the keypad layout (built-in or --layout), then describe how each
+ * key is pressed, the return home and the key-to-key moves
+ * @return: 0 on success, -1 if the layout cannot be read or a key is out of reach
  */
-void move_to_home_position() {
-    printf("Returning to home position...\n");
-    
-    // Reset joint 3
-    strcpy(handlerName, "/base_link_respondable[0]/joint_3");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(3000);
-
-    // Reset joint 2
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(15000);
-
-    // Reset joint 1
-    strcpy(handlerName, "/base_link_respondable[0]/joint_1");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(3000);
-
-    // Final reset of joint 2
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(2000);
+int build_pose_table() {
+    float zero[MAX_JOINTS] = {0};
+    KeyLayout layout;
+    KeySolutions solutions;
+    int key;
+
+    if (layout_open(&layout, arm.layoutFrom, SCENE_KEYPAD) == -1 ||
+        layout_solve(&layout, &NIRYO_ONE_GEOMETRY, zero, &solutions) == -1) {
+        return -1;
+    }
+    for (key = 0; key < KEY_COUNT; key++) {
+        numj1[key] = solutions.press[key][JOINT_1];
+        numj2[key] = solutions.press[key][JOINT_2];
+        numj3[key] = solutions.press[key][JOINT_3];
+        backj2[key] = solutions.hover[key][JOINT_2];
+    }
+    memcpy(reference, solutions.press[KEY_REFERENCE], sizeof(reference));
+    memcpy(hover, solutions.hover, sizeof(hover));
+    arm.keyHover = hover;
+
+    table.scene = SCENE_KEYPAD;
+    for (key = 0; key < KEY_COUNT; key++) {
+        MotionPhase* phases = table.keys[key];
+        memset(phases, 0, sizeof(table.keys[key]));
+
+        // Move joints 3 and 2 together above the key
+        phases[0].mask = JOINT_MASK(JOINT_3) | JOINT_MASK(JOINT_2);
+        phases[0].targets[JOINT_3] = numj3[key];
+        phases[0].targets[JOINT_2] = numj2[key];
+
+        // Move joint 1 to position (only after the approach, to clear the keys)
+        phases[1].mask = JOINT_MASK(JOINT_1);
+        phases[1].targets[JOINT_1] = numj1[key];
+
+        // Return joint 2 to intermediate position
+        phases[2].mask = JOINT_MASK(JOINT_2);
+        phases[2].targets[JOINT_2] = backj2[key];
+
+        table.phaseCount[key] = 3;
+    }
+
+    // Home: joints 3 and 2 together, then joint 1, then the final reset of joint 2
+    memset(table.home, 0, sizeof(table.home));
+    table.home[0].mask = JOINT_MASK(JOINT_3) | JOINT_MASK(JOINT_2);
+    table.home[1].mask = JOINT_MASK(JOINT_1);
+    table.home[2].mask = JOINT_MASK(JOINT_2);
+    table.homeCount = 3;
+
+    // Direct moves between keys (each replaces a trip to the reference point)
+    build_keypad_transitions(table.transitions, numj3, numj1, backj2, reference);
+    return 0;
 }
 
 /**
- * Move to a defined reference point (above digit 5 position)
+ * Keep the journal entry of a compiled ballot until its confirm key is done
  */
-void move_to_reference_point() {
-    printf("Moving to reference point...\n");
-    
-    // Move joint 2 to reference position
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 4, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(4000);
-
-    // Move joint 1 to reference position
-    strcpy(handlerName, "/base_link_respondable[0]/joint_1");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 11, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(2000);
-
-    // Move joint 3 to reference position
-    strcpy(handlerName, "/base_link_respondable[0]/joint_3");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)PI / 45, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(2000);
+void queue_compiled(const JournalEntry* entry) {
+    // Entries before castCount are journaled already
+    if (castCount > 0) {
+        memmove(compiled, compiled + castCount, (compiledCount - castCount) * sizeof(JournalEntry));
+        compiledCount -= castCount;
+        castCount = 0;
+    }
+    if (compiledCount == compiledCapacity) {
+        compiledCapacity = compiledCapacity ? compiledCapacity * 2 : 256;
+        compiled = (JournalEntry*)realloc(compiled, compiledCapacity * sizeof(JournalEntry));
+    }
+    compiled[compiledCount++] = *entry;
 }
 
 /**
- * Perform vote confirmation sequence
+ * Open the voting file
+ * @return: 0 on success, -1 if it could not be opened
  */
-void confirm_vote() {
-    printf("Confirming vote...\n");
-    
-    // Move to confirmation position - joint 3
-    strcpy(handlerName, "/base_link_respondable[0]/joint_3");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 70, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(6000);
-
-    // Confirmation sequence - joint 2
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 8, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(6000);
-
-    // Confirmation sequence - joint 1
-    strcpy(handlerName, "/base_link_respondable[0]/joint_1");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 8, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(6000);
-
-    // Final confirmation movement - joint 2
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 3.55, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(7000);
+int open_ballots(BallotReader* reader, const char* input) {
+    printf("Opening voting sequences file...\n");
+    if (ballot_reader_open(reader, input) == -1) {
+        printf("ERROR: Failed to open %s\n", input);
+        printf("Please ensure the file exists and contains voting sequences.\n");
+        return -1;
+    }
+    printf("SUCCESS: File opened successfully\n\n");
+    return 0;
 }
 
 /**
- * Initialize connection to CoppeliaSim
+ * Compile every voting sequence of an open file, followed by the return
+ * home, and close it. With run set, each ballot is cast on the arm as soon
+ * as it is compiled, so the program only ever holds one ballot and memory
+ * stays flat however long the file is; otherwise the whole file is compiled
+ * into program (--compile).
+ * @return: Moves that did not finish within their time limit (0 when only
+ *          compiling), or -1 if the link could not be restored
+ */
+long compile_ballots(MotionProgram* program, BallotReader* reader, int run) {
+    BallotView ballot;
+    JournalEntry entry;
+    long skipped = 0, late = 0, ret = 0;
+    int status;
+
+    // The reader already rejected lines with non-digits
+    while ((status = ballot_reader_next(reader, &ballot)) == 1) {
+        if (arm.journalTo != NULL) {
+            entry = journal_entry(ballot.offset, ballot.digits, ballot.length);
+            if (journal_contains(&journal, &entry)) {
+                skipped++;
+                continue;
+            }
+            queue_compiled(&entry);
+        }
+        if (run) {
+            program_clear(program);
+        }
+        ballot_cache_add_ballot(&cache, program, &table, ballot.digits, ballot.length);
+        if (!run) {
+            printf("Compiled voting sequence: %.*s (length: %d)\n", (int)ballot.length, ballot.digits, (int)ballot.length);
+            continue;
+        }
+        printf("Casting voting sequence: %.*s (length: %d)\n", (int)ballot.length, ballot.digits, (int)ballot.length);
+        if ((ret = program_run(&arm, program)) == -1) {
+            break;
+        }
+        late += ret;
+    }
+    if (status == -1) {
+        printf("ERROR: Failed while reading the voting file\n");
+    }
+    if (reader->invalidLines > 0) {
+        printf("WARNING: %ld invalid line(s) skipped\n", reader->invalidLines);
+    }
+    if (skipped > 0) {
+        printf("Skipped %ld ballot(s) already cast according to %s\n", skipped, arm.journalTo);
+    }
+    ballot_reader_close(reader);
+    if (ret == -1) {
+        return -1;
+    }
+
+    if (run) {
+        program_clear(program);
+    }
+    program_add_home(program, &table);
+    if (run && (ret = program_run(&arm, program)) == -1) {
+        return -1;
+    }
+    late += ret;
+    if (run) {
+        printf("Motion program: %ld ballot(s) compiled one at a time, %ld redundant move(s) merged\n",
+               program->ballots, program->merged);
+    } else {
+        printf("Motion program: %ld ballot(s), %ld step(s), %ld redundant move(s) merged\n",
+               program->ballots, program->count, program->merged);
+    }
+    ballot_cache_print(&cache);
+    printf("\n");
+    return late;
+}
+
+/**
+ * Initialize connection to CoppeliaSim and resolve the joint handles
  * @return: 0 on success, -1 on failure
  */
 int initialize_connection() {
-    // Connect to CoppeliaSim on default port
-    clientID = simxStart((simxChar*)"127.0.0.1", 19999, true, true, 2000, 5);
-    extApi_sleepMs(500);
-
-    if (clientID == -1) {
+    // Connect to CoppeliaSim (--host, --port)
+    if (arm_connect(&arm, arm.host, arm.port, 0) == -1) {
         printf("ERROR: Failed to connect to CoppeliaSim!\n");
         printf("Make sure CoppeliaSim is running and remote API is enabled.\n");
         return -1;
@@ -182,6 +266,174 @@ int initialize_connection() {
     }
 }
 
+/**
+ * Bring a connected arm from zero to the reference point (above digit 5)
+ */
+void setup_arm(NiryoArm* session) {
+    float zero[KEYPAD_JOINTS] = {0, 0, 0};
+
+    arm_move_planned(session, zero, JOINT_MASK(JOINT_3));
+    arm_move_planned(session, reference, JOINT_MASK(JOINT_3));
+
+    // Move to initial joint positions
+    arm_move_planned(session, reference, JOINT_MASK(JOINT_2) | JOINT_MASK(JOINT_1));
+}
+
+/**
+ * Take the next ballot from the shared queue, passing over the ones already cast
+ * @param digits: Buffer receiving a copy of the ballot (grown as needed)
+ * @param entry: Receives the journal identity of the ballot
+ * @return: Length of the ballot, or -1 once the queue is empty
+ */
+long next_ballot(char** digits, size_t* capacity, JournalEntry* entry) {
+    BallotView ballot;
+    long length = -1;
+    int status;
+
+    // Views point into the mapped window, which moves on the next call: copy under the lock
+    pthread_mutex_lock(&queueLock);
+    while ((status = ballot_reader_next(&queue, &ballot)) == 1 && arm.journalTo != NULL) {
+        *entry = journal_entry(ballot.offset, ballot.digits, ballot.length);
+        if (!journal_contains(&journal, entry)) {
+            break;
+        }
+    }
+    if (status == 1) {
+        if (ballot.length > *capacity) {
+            *capacity = ballot.length;
+            *digits = (char*)realloc(*digits, *capacity);
+        }
+        memcpy(*digits, ballot.digits, ballot.length);
+        length = (long)ballot.length;
+    }
+    pthread_mutex_unlock(&queueLock);
+    return length;
+}
+
+/**
+ * Thread of one arm: cast ballots from the queue until it is empty, then go home
+ */
+void* arm_worker(void* data) {
+    ArmWorker* worker = (ArmWorker*)data;
+    NiryoArm* session = &worker->arm;
+    MotionProgram program;
+    JournalEntry entry;
+    char* digits = NULL;
+    size_t capacity = 0;
+    long length, late = 0, failed;
+    long long start;
+
+    // Each arm of the scene listens on its own remote API port, counted from --port
+    int port = session->port + session->instance;
+    if (arm_connect(session, session->host, port, session->instance) == -1) {
+        printf("ERROR: Arm [%d] could not connect on port %d, its ballots go to the other arms\n",
+               session->instance, port);
+        return NULL;
+    }
+    setup_arm(session);
+    worker->connected = 1;
+
+    // Ballots are compiled one at a time; the compiler state follows the arm across them
+    program_init(&program, SCENE_KEYPAD);
+    program_set_start(&program, reference, KEYPAD_MASK);
+    start = clock_now_ms(&session->clock);
+    while ((length = next_ballot(&digits, &capacity, &entry)) >= 0) {
+        program_clear(&program);
+        ballot_cache_add_ballot(&cache, &program, &table, digits, length);
+        printf("Arm [%d] casting voting sequence: %.*s\n", session->instance, (int)length, digits);
+        failed = session->stats.failedBallots;
+        if ((late = program_run(session, &program)) == -1) {
+            printf("ERROR: Arm [%d] lost its link for good, ballot %.*s was not completed\n",
+                   session->instance, (int)length, digits);
+            break;
+        }
+        worker->late += late;
+        if (session->stats.failedBallots > failed) {
+            worker->failed++;
+            continue;
+        }
+        if (arm.journalTo != NULL) {
+            journal_append(&journal, &entry);
+        }
+        worker->ballots++;
+        worker->digits += length;
+    }
+    if (late != -1) {
+        program_clear(&program);
+        program_add_home(&program, &table);
+        late = program_run(session, &program);
+        worker->late += late > 0 ? late : 0;
+    }
+    worker->elapsedMs = clock_now_ms(&session->clock) - start;
+
+    program_free(&program);
+    free(digits);
+    arm_disconnect(session);
+    return NULL;
+}
+
+/**
+ * Share the voting file between arms [0]..[arm.arms - 1] and report per-arm stats
+ * @return: 0 on success, -1 if the file could not be read, no arm connected or a ballot failed
+ */
+int run_arms(const char* input) {
+    ArmWorker* workers = (ArmWorker*)calloc(arm.arms, sizeof(ArmWorker));
+    ArmStats total;
+    long ballots = 0, failed = 0;
+    int i, connected = 0;
+
+    if (ballot_reader_open(&queue, input) == -1) {
+        printf("ERROR: Failed to open %s\n", input);
+        free(workers);
+        return -1;
+    }
+
+    printf("Driving %d arms in parallel...\n", arm.arms);
+    for (i = 0; i < arm.arms; i++) {
+        workers[i].arm = arm;
+        workers[i].arm.instance = i;
+        pthread_create(&workers[i].thread, NULL, arm_worker, &workers[i]);
+    }
+    for (i = 0; i < arm.arms; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    if (queue.invalidLines > 0) {
+        printf("WARNING: %ld invalid line(s) skipped\n", queue.invalidLines);
+    }
+    ballot_reader_close(&queue);
+
+    printf("\nArm  Ballots  Failed  Digits  Late moves  Time (s)  Ballots/min\n");
+    for (i = 0; i < arm.arms; i++) {
+        ArmWorker* worker = &workers[i];
+        if (!worker->connected) {
+            printf("[%d]  not connected\n", i);
+            continue;
+        }
+        connected++;
+        ballots += worker->ballots;
+        failed += worker->failed;
+        printf("[%d]  %7ld  %6ld  %6ld  %10ld  %8.1f  %11.2f\n", i, worker->ballots, worker->failed, worker->digits, worker->late,
+               worker->elapsedMs / 1000.0, worker->elapsedMs > 0 ? worker->ballots * 60000.0 / worker->elapsedMs : 0.0);
+    }
+    printf("Total: %ld ballot(s) on %d arm(s)\n", ballots, connected);
+    if (failed > 0) {
+        printf("ERROR: %ld ballot(s) were given up after a failed press and not confirmed\n", failed);
+    }
+    ballot_cache_print(&cache);
+
+    // Latencies of every arm together
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < arm.arms; i++) {
+        arm_merge_stats(&total, &workers[i].arm.stats);
+    }
+    arm_print_stats(&total, "Latency report, all arms (ms)");
+    printf("\n");
+
+    free(workers);
+    return connected > 0 && failed == 0 ? 0 : -1;
+}
+
 /**
  * Main program function
  */
@@ -189,82 +441,125 @@ int main(int argc, char* argv[]) {
     printf("=== Niryo One Robotic Arm Controller ===\n");
     printf("Starting voting simulation...\n\n");
 
+    // Read options and the voting file name before connecting
+    const char* input = "voting_sequences.txt";
+    arm_init(&arm, SCENE_KEYPAD);
+    if (arm_parse_options(&arm, argc, argv, &input) == -1) {
+        return 1;
+    }
+    arm_report_on_signal(SIGUSR1);
+
+    if (build_pose_table() == -1) {
+        return 1;
+    }
+    ballot_cache_init(&cache, (size_t)arm.ballotCacheKb * 1024);
+
+    // Ballots cast by an earlier run are left out
+    if (arm.journalTo != NULL) {
+        if (arm.programFrom != NULL) {
+            printf("ERROR: --journal needs the voting file, not a compiled --program\n");
+            return 1;
+        }
+        if (journal_open(&journal, arm.journalTo) == -1) {
+            return 1;
+        }
+        printf("Journal %s: %ld ballot(s) already cast\n", arm.journalTo, journal.count);
+        arm_ballot_observer = on_ballot_cast;
+    }
+
+    // Several arms share the ballots as they come; programs are built per arm
+    if (arm.arms > 1) {
+        if (arm.compileTo != NULL || arm.programFrom != NULL || arm.clock.mode == CLOCK_SYNC) {
+            printf("ERROR: --arms cannot be combined with --compile, --program or --clock sync\n");
+            return 1;
+        }
+        int failed = run_arms(input) == -1;
+        ballot_cache_free(&cache);
+        if (arm.journalTo != NULL) {
+            journal_close(&journal);
+        }
+        if (failed) {
+            return 1;
+        }
+        printf("=== Voting simulation completed successfully! ===\n");
+        return 0;
+    }
+
+    // Load a compiled program, or open the ballots before touching the arm
+    // (--compile compiles them all; a run compiles each one as it comes)
+    MotionProgram program;
+    BallotReader reader;
+    program_init(&program, SCENE_KEYPAD);
+    program_set_start(&program, reference, KEYPAD_MASK);
+    if (arm.programFrom != NULL) {
+        if (program_load(&program, arm.programFrom) == -1) {
+            return 1;
+        }
+        printf("Loaded motion program %s: %ld ballot(s), %ld step(s)\n\n", arm.programFrom, program.ballots, program.count);
+    } else if (open_ballots(&reader, input) == -1) {
+        exit(1);
+    } else if (arm.compileTo != NULL) {
+        compile_ballots(&program, &reader, 0);
+    }
+
+    if (arm.compileTo != NULL) {
+        ballot_cache_free(&cache);
+        if (program_save(&program, arm.compileTo) == -1) {
+            printf("ERROR: Could not write %s\n", arm.compileTo);
+            program_free(&program);
+            return 1;
+        }
+        printf("SUCCESS: Motion program written to %s\n", arm.compileTo);
+        program_free(&program);
+        return 0;
+    }
+
     // Initialize connection
     if (initialize_connection() == -1) {
+        if (arm.programFrom == NULL) {
+            ballot_reader_close(&reader);
+        }
+        program_free(&program);
         return 1;
     }
 
     // Set initial position (above digit 5 - reference point)
     printf("Setting up initial position...\n");
-    strcpy(handlerName, "/base_link_respondable[0]/joint_3");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(1000);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)PI / 45, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(2000);
+    setup_arm(&arm);
 
-    // Move to initial joint positions
-    strcpy(handlerName, "/base_link_respondable[0]/joint_2");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 4, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(12000);
-
-    strcpy(handlerName, "/base_link_respondable[0]/joint_1");
-    simxGetObjectHandle(clientID, handlerName, &handler, (simxInt)simx_opmode_oneshot_wait);
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)-PI / 11, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(3000);
-
-    // Read voting sequences from file
-    int digit;
-    char number[10];
-    int i, len;
-    FILE* file;
-    
-    printf("Opening voting sequences file...\n");
-    file = fopen("voting_sequences.txt", "r");
-    if (file == NULL) {
-        printf("ERROR: Failed to open voting_sequences.txt\n");
-        printf("Please ensure the file exists and contains voting sequences.\n");
-        simxFinish(clientID);
-        exit(1);
+    // Press every key and return home
+    long late;
+    if (arm.programFrom != NULL) {
+        printf("Running %ld voting sequence(s)...\n", program.ballots);
+        late = program_run(&arm, &program);
     } else {
-        printf("SUCCESS: File opened successfully\n\n");
-        
-        // Process each voting sequence
-        while (!feof(file)) {
-            if (fscanf(file, "%s", number) == 1) {
-                len = strlen(number);
-                printf("Processing voting sequence: %s (length: %d)\n", number, len);
-                
-                // Process each digit in the sequence
-                for (i = 0; i < len; i++) {
-                    digit = number[i] - '0';  // Convert char to int
-                    
-                    if (digit >= 0 && digit <= 9) {
-                        move_digit(digit);
-                        move_to_reference_point();  // Return to reference point after each digit
-                    } else {
-                        printf("WARNING: Invalid digit '%c' encountered, skipping...\n", number[i]);
-                    }
-                }
-                
-                // Confirm vote after completing the sequence
-                confirm_vote();
-                move_to_reference_point();  // Return to reference point after confirmation
-                
-                printf("Completed voting sequence: %s\n\n", number);
-            }
-        }
+        late = compile_ballots(&program, &reader, 1);
     }
-    fclose(file);
-
-    // Return to home position at the end
-    move_to_home_position();
+    ballot_cache_free(&cache);
+    if (arm.journalTo != NULL) {
+        journal_close(&journal);
+        free(compiled);
+    }
+    if (late == -1) {
+        printf("ERROR: The link to CoppeliaSim could not be restored, voting stopped\n");
+        program_free(&program);
+        arm_disconnect(&arm);
+        return 1;
+    }
+    if (late > 0) {
+        printf("WARNING: %ld move(s) did not finish within their time limit\n", late);
+    }
+    program_free(&program);
 
     // Close connection
     printf("Closing connection to CoppeliaSim...\n");
-    simxFinish(clientID);
-    
+    arm_disconnect(&arm);
+    arm_print_stats(&arm.stats, "Latency report (ms)");
+
+    if (arm.stats.failedBallots > 0) {
+        printf("ERROR: %ld ballot(s) were given up after a failed press and not confirmed\n", arm.stats.failedBallots);
+        return 1;
+    }
     printf("=== Voting simulation completed successfully! ===\n");
     return 0;
 }
@@ -0,0 +1,39 @@
+/*
+ * Joint Trace Dump
+ *
+ * Prints a trace recorded with --trace as CSV, one line per sample:
+ * time_ms, ballot, key, then the commanded and the actual position of
+ * every joint (empty when the position was not available).
+ *
+ * Usage: trace_dump <trace file> [csv file]
+ */
+
+#include <stdio.h>
+
+#include "joint_trace.h"
+
+int main(int argc, char* argv[]) {
+    FILE* out = stdout;
+    long samples;
+
+    if (argc < 2 || argc > 3) {
+        printf("Usage: %s <trace file> [csv file]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 3) {
+        out = fopen(argv[2], "w");
+        if (out == NULL) {
+            printf("ERROR: Could not write %s\n", argv[2]);
+            return 1;
+        }
+    }
+
+    samples = trace_dump_csv(argv[1], out);
+    if (out != stdout) {
+        fclose(out);
+        if (samples >= 0) {
+            printf("SUCCESS: %ld sample(s) written to %s\n", samples, argv[2]);
+        }
+    }
+    return samples >= 0 ? 0 : 1;
+}
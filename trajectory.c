@@ -0,0 +1,108 @@
+/*
+ * Joint Trajectory Planner
+ */
+
+#include <math.h>
+
+#include "trajectory.h"
+
+// Shoulder, arm and elbow are slower than the wrist
+const JointLimits NIRYO_ONE_LIMITS = {
+    {1.0f, 1.0f, 1.0f, 1.5f, 1.5f, 1.5f},
+    {1.5f, 1.5f, 1.5f, 2.0f, 2.0f, 2.0f}
+};
+
+// Settle time added to every planned move (a key layout file may change it)
+static int settleMs = PLAN_SETTLE_MS;
+
+/**
+ * Shortest time to cover a distance starting and ending at rest
+ */
+static float minimum_time(float distance, float velocity, float acceleration) {
+    // Triangle profile when the cruise velocity is never reached
+    if (distance <= velocity * velocity / acceleration) {
+        return 2 * sqrtf(distance / acceleration);
+    }
+    return distance / velocity + velocity / acceleration;
+}
+
+float plan_move(Trajectory* trajectory, const float* from, const float* to, int mask, const JointLimits* limits) {
+    float duration = 0, distance, a, discriminant;
+    int j;
+
+    trajectory->mask = mask;
+    for (j = 0; j < MAX_JOINTS; j++) {
+        JointProfile* profile = &trajectory->joints[j];
+
+        profile->start = (mask & JOINT_MASK(j)) ? from[j] : 0;
+        profile->distance = (mask & JOINT_MASK(j)) ? to[j] - from[j] : 0;
+        profile->velocity = 0;
+        profile->acceleration = limits->maxAcceleration[j];
+
+        distance = fabsf(profile->distance);
+        if (distance > 0) {
+            float t = minimum_time(distance, limits->maxVelocity[j], limits->maxAcceleration[j]);
+            if (t > duration) {
+                duration = t;
+            }
+        }
+    }
+
+    // Slow every joint down to the common duration: d = v * (T - v / a)
+    for (j = 0; j < MAX_JOINTS; j++) {
+        JointProfile* profile = &trajectory->joints[j];
+
+        distance = fabsf(profile->distance);
+        if (distance == 0) {
+            continue;
+        }
+        a = profile->acceleration;
+        discriminant = a * a * duration * duration - 4 * a * distance;
+        profile->velocity = (a * duration - sqrtf(discriminant > 0 ? discriminant : 0)) / 2;
+    }
+
+    trajectory->duration = duration;
+    return duration;
+}
+
+int plan_duration_ms(const float* from, const float* to, int mask, const JointLimits* limits) {
+    Trajectory trajectory;
+
+    return (int)ceilf(plan_move(&trajectory, from, to, mask, limits) * 1000) + settleMs;
+}
+
+float plan_sample(const Trajectory* trajectory, int joint, float t) {
+    const JointProfile* profile = &trajectory->joints[joint];
+    float distance = fabsf(profile->distance);
+    float direction = profile->distance < 0 ? -1.0f : 1.0f;
+    float rampTime, covered;
+
+    if (distance == 0 || profile->velocity == 0) {
+        return profile->start + profile->distance;
+    }
+    if (t <= 0) {
+        return profile->start;
+    }
+    if (t >= trajectory->duration) {
+        return profile->start + profile->distance;
+    }
+
+    rampTime = profile->velocity / profile->acceleration;
+    if (t < rampTime) {
+        covered = 0.5f * profile->acceleration * t * t;
+    } else if (t < trajectory->duration - rampTime) {
+        covered = 0.5f * profile->velocity * rampTime + profile->velocity * (t - rampTime);
+    } else {
+        float remaining = trajectory->duration - t;
+        covered = distance - 0.5f * profile->acceleration * remaining * remaining;
+    }
+    return profile->start + direction * covered;
+}
+
+void plan_set_settle_ms(int ms) {
+    settleMs = ms;
+}
+
+int plan_settle_ms() {
+    return settleMs;
+}
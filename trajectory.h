@@ -0,0 +1,74 @@
+/*
+ * Joint Trajectory Planner
+ *
+ * Plans time-optimal trapezoidal velocity profiles between two poses under
+ * per-joint velocity and acceleration limits. The joint that needs the most
+ * time sets the duration of the move and every other joint is slowed down
+ * to finish at the same instant, so the arm moves along a synchronized
+ * profile whose duration is exact instead of a hand-tuned dwell time.
+ */
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "niryo_arm.h"
+
+// Default time added after the profile for the joint controller to settle within tolerance
+#define PLAN_SETTLE_MS 250
+
+// Velocity (rad/s) and acceleration (rad/s^2) limits indexed by Joint
+typedef struct {
+    float maxVelocity[MAX_JOINTS];
+    float maxAcceleration[MAX_JOINTS];
+} JointLimits;
+
+// Limits of the Niryo One joints used for every plan (the keypad scene's
+// joint_1..joint_3 are the first three joints of the same arm)
+extern const JointLimits NIRYO_ONE_LIMITS;
+
+// Profile of one joint: accelerate, cruise, decelerate
+typedef struct {
+    float start;          // Start position (radians)
+    float distance;       // Signed distance to the goal (radians)
+    float velocity;       // Cruise velocity (rad/s), reduced to finish with the slowest joint
+    float acceleration;   // Acceleration used on both ramps (rad/s^2)
+} JointProfile;
+
+// Synchronized move of several joints
+typedef struct {
+    int mask;                        // Joints that move
+    float duration;                  // Duration of the profile in seconds
+    JointProfile joints[MAX_JOINTS];
+} Trajectory;
+
+/**
+ * Plan a synchronized move of the masked joints
+ * @param from, to: Start and goal poses indexed by Joint (only masked joints are read)
+ * @return: Duration of the move in seconds
+ */
+float plan_move(Trajectory* trajectory, const float* from, const float* to, int mask, const JointLimits* limits);
+
+/**
+ * Time limit for a move: the planned duration plus the settle time
+ * @return: Milliseconds
+ */
+int plan_duration_ms(const float* from, const float* to, int mask, const JointLimits* limits);
+
+/**
+ * Position of one joint along a planned move
+ * @param t: Time since the start of the move in seconds (clamped to the duration)
+ */
+float plan_sample(const Trajectory* trajectory, int joint, float t);
+
+/**
+ * Change the settle time added by plan_duration_ms() (PLAN_SETTLE_MS until
+ * then). Call it before building any table, not while arms are running.
+ */
+void plan_set_settle_ms(int ms);
+
+/**
+ * Settle time currently added by plan_duration_ms()
+ */
+int plan_settle_ms();
+
+#endif
@@ -0,0 +1,307 @@
+/*
+ * Simulator Transport
+ *
+ * The remote calls the arm session and the clock make, behind one thin
+ * interface: connect, resolve a handle, send a joint target, read a joint
+ * position or an integer signal, pause the communication thread, step a
+ * synchronous scene, and the time and sleep of the link.
+ *
+ * Each backend is a specialization of Transport<> with static inline
+ * functions, chosen at compile time by TRANSPORT_BACKEND, so every call
+ * compiles straight down to the backend's own function (no function
+ * pointers on the per-poll path):
+ *   TRANSPORT_REMOTE_API  CoppeliaSim legacy remote API (-I./remoteApi -lremoteApi)
+ *   TRANSPORT_SIM         in-process stand-in (-Iextapi_sim, extapi_sim/extApi.c)
+ *   TRANSPORT_REPLAY      answers from a call log recorded with --record
+ *                         (call_log.h; any extApi.h for the types, no library)
+ * The first two export the simx* symbols, so one binary holds only one of
+ * them. Without TRANSPORT_BACKEND the backend follows the extApi.h found on
+ * the include path. Return codes are the remote API flags (simx_return_ok...).
+ *
+ * Link wraps the chosen backend in Recorded<>, which writes every call to
+ * the call log while one is being recorded (one pointer test otherwise).
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+// Include CoppeliaSim remote API (or the stand-in, whichever is on the include path)
+extern "C" {
+#include "extApi.h"
+}
+
+#include "call_log.h"
+
+// Backends known to the controllers
+#define TRANSPORT_REMOTE_API 0
+#define TRANSPORT_SIM 1
+#define TRANSPORT_REPLAY 2
+
+#ifndef TRANSPORT_BACKEND
+#ifdef EXTAPI_SIM_H
+#define TRANSPORT_BACKEND TRANSPORT_SIM
+#else
+#define TRANSPORT_BACKEND TRANSPORT_REMOTE_API
+#endif
+#endif
+
+#if TRANSPORT_BACKEND == TRANSPORT_SIM && !defined(EXTAPI_SIM_H)
+#error "TRANSPORT_SIM needs the stand-in header: build with -Iextapi_sim"
+#endif
+
+// Default address of the simulator (--host, --port)
+#define DEFAULT_HOST "127.0.0.1"
+#define DEFAULT_PORT 19999
+
+// Time the first connection attempt may take, and the communication thread cycle
+#define CONNECT_TIMEOUT_MS 2000
+#define COMM_CYCLE_MS 5
+
+template <int Backend>
+struct Transport;
+
+// CoppeliaSim legacy remote API
+template <>
+struct Transport<TRANSPORT_REMOTE_API> {
+    static const char* name() { return "remote"; }
+
+    /**
+     * Open a connection
+     * @return: Client id, or -1 if the simulator could not be reached
+     */
+    static inline int connect(const char* host, int port) {
+        return simxStart((simxChar*)host, port, true, true, CONNECT_TIMEOUT_MS, COMM_CYCLE_MS);
+    }
+    static inline void disconnect(int clientID) { simxFinish(clientID); }
+
+    /**
+     * Id of the connection behind a client, -1 once the link is lost
+     */
+    static inline int connection_id(int clientID) { return simxGetConnectionId(clientID); }
+
+    static inline int get_handle(int clientID, const char* name, int* handle) {
+        return simxGetObjectHandle(clientID, name, handle, simx_opmode_oneshot_wait);
+    }
+
+    /**
+     * Send a joint target
+     * @param wait: 1 to wait for the reply, 0 to queue it (the reply of the
+     *              previous command to the joint comes back instead)
+     */
+    static inline int set_target(int clientID, int handle, float position, int wait) {
+        return simxSetJointTargetPosition(clientID, handle, (simxFloat)position,
+                                          wait ? simx_opmode_oneshot_wait : simx_opmode_oneshot);
+    }
+
+    /**
+     * Subscribe to a joint position, so read_position() is served locally
+     */
+    static inline int stream_position(int clientID, int handle) {
+        simxFloat position;
+        return simxGetJointPosition(clientID, handle, &position, simx_opmode_streaming);
+    }
+
+    /**
+     * Last streamed position of a joint (simx_return_novalue_flag until the first one arrives)
+     */
+    static inline int read_position(int clientID, int handle, float* position) {
+        simxFloat value = 0;
+        int ret = simxGetJointPosition(clientID, handle, &value, simx_opmode_buffer);
+        *position = (float)value;
+        return ret;
+    }
+
+    /**
+     * Position of a joint asked with a round trip
+     */
+    static inline int query_position(int clientID, int handle, float* position) {
+        simxFloat value = 0;
+        int ret = simxGetJointPosition(clientID, handle, &value, simx_opmode_blocking);
+        *position = (float)value;
+        return ret;
+    }
+
+    static inline int stream_signal(int clientID, const char* name) {
+        simxInt value;
+        return simxGetIntegerSignal(clientID, name, &value, simx_opmode_streaming);
+    }
+    static inline int read_signal(int clientID, const char* name, int* value) {
+        *value = 0;
+        return simxGetIntegerSignal(clientID, name, value, simx_opmode_buffer);
+    }
+
+    /**
+     * Hold queued commands while pause is 1, and send them in one message when it goes back to 0
+     */
+    static inline int pause(int clientID, int pause) { return simxPauseCommunication(clientID, (simxUChar)pause); }
+    static inline int ping(int clientID) {
+        simxInt pingTime;
+        return simxGetPingTime(clientID, &pingTime);
+    }
+
+    static inline int synchronous(int clientID, int enable) { return simxSynchronous(clientID, (simxUChar)enable); }
+    static inline int trigger(int clientID) { return simxSynchronousTrigger(clientID); }
+
+    static inline long long now_ms() { return extApi_getTimeInMs(); }
+    static inline void sleep_ms(int ms) { extApi_sleepMs(ms); }
+};
+
+// In-process stand-in: the same calls, answered by the simulated scene of
+// extapi_sim/ on its simulated clock
+template <>
+struct Transport<TRANSPORT_SIM> : Transport<TRANSPORT_REMOTE_API> {
+    static const char* name() { return "sim"; }
+};
+
+// Recorded session played back (call_log.h): nothing leaves the process
+template <>
+struct Transport<TRANSPORT_REPLAY> {
+    static const char* name() { return "replay"; }
+
+    static inline int connect(const char* host, int port) {
+        (void)host;
+        return replay_connect(port);
+    }
+    static inline void disconnect(int clientID) { replay_disconnect(clientID); }
+    static inline int connection_id(int clientID) { return replay_connection_id(clientID); }
+    static inline int get_handle(int clientID, const char* name, int* handle) {
+        return replay_get_handle(clientID, name, handle);
+    }
+    static inline int set_target(int clientID, int handle, float position, int wait) {
+        (void)position;
+        return replay_set_target(clientID, handle, wait);
+    }
+    static inline int stream_position(int clientID, int handle) {
+        return replay_stream(clientID, LOG_STREAM_POSITION, handle);
+    }
+    static inline int read_position(int clientID, int handle, float* position) {
+        return replay_read_position(clientID, handle, position, 0);
+    }
+    static inline int query_position(int clientID, int handle, float* position) {
+        return replay_read_position(clientID, handle, position, 1);
+    }
+    static inline int stream_signal(int clientID, const char* name) {
+        return replay_stream(clientID, LOG_STREAM_SIGNAL, call_log_name_key(name));
+    }
+    static inline int read_signal(int clientID, const char* name, int* value) {
+        return replay_read_signal(clientID, name, value);
+    }
+    static inline int pause(int clientID, int pause) { return replay_call(clientID, LOG_PAUSE, pause); }
+    static inline int ping(int clientID) { return replay_call(clientID, LOG_PING, 0); }
+    static inline int synchronous(int clientID, int enable) { return replay_call(clientID, LOG_SYNCHRONOUS, enable); }
+    static inline int trigger(int clientID) { return replay_call(clientID, LOG_TRIGGER, 0); }
+    static inline long long now_ms() { return replay_now_ms(); }
+    static inline void sleep_ms(int ms) { replay_sleep_ms(ms); }
+};
+
+/**
+ * A backend whose calls are also written to the call log while --record is on
+ */
+template <class Backend>
+struct Recorded {
+    static const char* name() { return Backend::name(); }
+
+    // Link time before a call, only read while recording
+    static inline long long begin() { return callRecording != NULL ? Backend::now_ms() : 0; }
+    static inline void end(int call, long long start, int clientID, int key, int ret, int integer, float position,
+                           int flags) {
+        if (callRecording != NULL) {
+            call_log_write(call, start, Backend::now_ms(), clientID, key, ret, integer, position, flags);
+        }
+    }
+
+    static inline int connect(const char* host, int port) {
+        long long start = begin();
+        int ret = Backend::connect(host, port);
+        end(LOG_CONNECT, start, -1, port, ret, 0, 0, LOG_WAITED);
+        return ret;
+    }
+    static inline void disconnect(int clientID) {
+        long long start = begin();
+        Backend::disconnect(clientID);
+        end(LOG_DISCONNECT, start, clientID, 0, 0, 0, 0, 0);
+    }
+    static inline int connection_id(int clientID) {
+        long long start = begin();
+        int ret = Backend::connection_id(clientID);
+        end(LOG_CONNECTION_ID, start, clientID, 0, ret, 0, 0, 0);
+        return ret;
+    }
+    static inline int get_handle(int clientID, const char* name, int* handle) {
+        long long start = begin();
+        int ret = Backend::get_handle(clientID, name, handle);
+        end(LOG_GET_HANDLE, start, clientID, call_log_name_key(name), ret, *handle, 0, LOG_WAITED);
+        return ret;
+    }
+    static inline int set_target(int clientID, int handle, float position, int wait) {
+        long long start = begin();
+        int ret = Backend::set_target(clientID, handle, position, wait);
+        end(LOG_SET_TARGET, start, clientID, handle, ret, 0, position, wait ? LOG_WAITED : 0);
+        return ret;
+    }
+    static inline int stream_position(int clientID, int handle) {
+        long long start = begin();
+        int ret = Backend::stream_position(clientID, handle);
+        end(LOG_STREAM_POSITION, start, clientID, handle, ret, 0, 0, 0);
+        return ret;
+    }
+    static inline int read_position(int clientID, int handle, float* position) {
+        long long start = begin();
+        int ret = Backend::read_position(clientID, handle, position);
+        end(LOG_READ_POSITION, start, clientID, handle, ret, 0, *position, 0);
+        return ret;
+    }
+    static inline int query_position(int clientID, int handle, float* position) {
+        long long start = begin();
+        int ret = Backend::query_position(clientID, handle, position);
+        end(LOG_QUERY_POSITION, start, clientID, handle, ret, 0, *position, LOG_WAITED);
+        return ret;
+    }
+    static inline int stream_signal(int clientID, const char* name) {
+        long long start = begin();
+        int ret = Backend::stream_signal(clientID, name);
+        end(LOG_STREAM_SIGNAL, start, clientID, call_log_name_key(name), ret, 0, 0, 0);
+        return ret;
+    }
+    static inline int read_signal(int clientID, const char* name, int* value) {
+        long long start = begin();
+        int ret = Backend::read_signal(clientID, name, value);
+        end(LOG_READ_SIGNAL, start, clientID, call_log_name_key(name), ret, *value, 0, 0);
+        return ret;
+    }
+    static inline int pause(int clientID, int pause) {
+        long long start = begin();
+        int ret = Backend::pause(clientID, pause);
+        end(LOG_PAUSE, start, clientID, pause, ret, 0, 0, 0);
+        return ret;
+    }
+    static inline int ping(int clientID) {
+        long long start = begin();
+        int ret = Backend::ping(clientID);
+        end(LOG_PING, start, clientID, 0, ret, 0, 0, LOG_WAITED);
+        return ret;
+    }
+    static inline int synchronous(int clientID, int enable) {
+        long long start = begin();
+        int ret = Backend::synchronous(clientID, enable);
+        end(LOG_SYNCHRONOUS, start, clientID, enable, ret, 0, 0, LOG_WAITED);
+        return ret;
+    }
+    static inline int trigger(int clientID) {
+        long long start = begin();
+        int ret = Backend::trigger(clientID);
+        end(LOG_TRIGGER, start, clientID, 0, ret, 0, 0, LOG_WAITED);
+        return ret;
+    }
+    static inline long long now_ms() { return Backend::now_ms(); }
+    static inline void sleep_ms(int ms) {
+        long long start = begin();
+        Backend::sleep_ms(ms);
+        end(LOG_SLEEP, start, -1, ms, 0, 0, 0, 0);
+    }
+};
+
+// Backend this build talks to
+typedef Recorded<Transport<TRANSPORT_BACKEND> > Link;
+
+#endif
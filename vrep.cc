@@ -4,487 +4,272 @@
 // Robotic Arm Control Example for CoppeliaSim
 // Author: Joao (original), comments and English translation by Artur
 // This code demonstrates how to control a robotic arm using the CoppeliaSim remote API.
+#include <math.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-extern "C" {
-#include "extApi.h"
+// CoppeliaSim remote API, the shared arm session and the key transition table
+#include "niryo_arm.h"
+#include "key_transitions.h"
+#include "motion_program.h"
+#include "key_layout.h"
+#include "ballot_journal.h"
+#include "ballot_store.h"
+#include "ballot_cache.h"
+
+// Key poses in radians, solved from the key layout once at startup
+float approachRad[KEY_COUNT][CHAIN_JOINTS];
+float pressedRad[KEY_COUNT][CHAIN_JOINTS];
+
+// Pose a missed press backs off to before pressing again: the one a repeated key lifts to
+float liftRad[KEY_COUNT][CHAIN_JOINTS];
+
+// Press sequence of every key, the rest pose and the direct moves between keys
+PoseTable table;
+
+// Votes already cast (--journal), and the compiled ones in program order until they are cast
+BallotJournal diario;
+JournalEntry* compilados = NULL;
+int qtdCompilados = 0;
+int qtdComputados = 0;
+
+// Called once the confirm key of a vote is done, or once the vote was given up (not journaled)
+void votoComputado(const NiryoArm* arm, int computado){
+    (void)arm;
+    if (qtdComputados < qtdCompilados) {
+        if (computado) {
+            journal_append(&diario, &compilados[qtdComputados]);
+        }
+        qtdComputados++;
+    }
 }
-void Pos0(int clientID,int handler){
-
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-    extApi_sleepMs(2000);
-
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
 
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-
-    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-}
-void carregaVotos(int* qtdVotos, char*** votos){
+// Read every vote of the file into the store: only the digits of each line are
+// typed, and lines without any are skipped
+void carregaVotos(const char* nome, BallotStore* votos){
     FILE* arq;
-    char voto[100];
-    arq = fopen("votos.txt", "r");
-    arq = fopen("votes.txt", "r");
+    char* linha = NULL;
+    size_t tamanho = 0;
+    ssize_t lidos;
+    long long posicao = 0;
+    long numeroLinha = 0;
+    arq = fopen(nome, "r");
     if (arq == NULL)
     {
         printf("Nao foi possivel computar votos\n"); exit(1);
-        printf("Could not load votes file\n"); exit(1);
-    while (!feof(arq)){
-        fscanf(arq, "%99[^\n]\n", voto);
-        digitos = strlen(voto);
-        (*qtdVotos)++;
-        (*votos) = (char**)realloc((*votos), (*qtdVotos) * sizeof(char*));
-        (*votos)[(*qtdVotos) - 1] = NULL;
-        (*votos)[(*qtdVotos) - 1] = (char*) realloc((*votos)[(*qtdVotos) - 1], digitos * sizeof(char));
-        strcpy((*votos)[(*qtdVotos) - 1], voto);
     }
+    while ((lidos = getline(&linha, &tamanho, arq)) != -1){
+        numeroLinha++;
+
+        // The vote starts at the first character that is not blank
+        long long inicio = posicao;
+        for (ssize_t j = 0; j < lidos && (linha[j] == ' ' || linha[j] == '\t' || linha[j] == '\r'); j++) {
+            inicio++;
+        }
+        posicao += lidos;
+
+        size_t digitos = 0;
+        for (ssize_t j = 0; j < lidos; j++) {
+            if (linha[j] >= '0' && linha[j] <= '9') {
+                linha[digitos++] = linha[j];
+            }
+        }
+        if (digitos > 0 && ballot_store_add(votos, linha, digitos, numeroLinha, inicio) == -1) {
+            printf("Memoria insuficiente para os votos\n"); exit(1);
+        }
+    }
+    free(linha);
     fclose(arq);
 }
 
-// Convert degrees to radians
-float radian(float degrees) {
-    float rad;
-    rad = (degrees * PI) / 180;
-    return rad;
+// Joints closer than this to their approach value do not take part in the press (radians)
+#define PRESS_STILL 1e-3f
+
+// Solve the key poses (built-in layout or --layout) and describe every press for the motion compiler
+int buildKeyTables(const char* layoutFile){
+    KeyLayout layout;
+    KeySolutions solucoes;
+    float repouso[CHAIN_JOINTS] = {0};
+    if (layout_open(&layout, layoutFile, SCENE_CHAIN) == -1 ||
+        layout_solve(&layout, &NIRYO_ONE_GEOMETRY, repouso, &solucoes) == -1) {
+        return -1;
+    }
+
+    table.scene = SCENE_CHAIN;
+    memset(table.keys, 0, sizeof(table.keys));
+    for (int k = 0; k < KEY_COUNT; k++) {
+        memcpy(approachRad[k], solucoes.hover[k], sizeof(approachRad[k]));
+        memcpy(pressedRad[k], approachRad[k], sizeof(pressedRad[k]));
+
+        // Approach the key with all joints together
+        table.keys[k][0].mask = ALL_JOINTS;
+        memcpy(table.keys[k][0].targets, approachRad[k], sizeof(approachRad[k]));
+        table.phaseCount[k] = 1;
+
+        // The press is kept serial: it only starts once the approach has finished
+        int pressMask = 0;
+        for (int j = 0; j < CHAIN_JOINTS; j++) {
+            if (fabsf(solucoes.press[k][j] - approachRad[k][j]) > PRESS_STILL) {
+                pressedRad[k][j] = solucoes.press[k][j];
+                pressMask |= JOINT_MASK(j);
+            }
+        }
+        if (pressMask != 0) {
+            table.keys[k][1].mask = pressMask;
+            memcpy(table.keys[k][1].targets, pressedRad[k], sizeof(pressedRad[k]));
+            table.phaseCount[k] = 2;
+        }
+    }
+
+    // Rest pose: every joint back to zero in one packet
+    memset(table.home, 0, sizeof(table.home));
+    table.home[0].mask = ALL_JOINTS;
+    table.homeCount = 1;
+
+    // Each transition replaces a trip back to the rest pose
+    build_chain_transitions(table.transitions, pressedRad, approachRad);
+    for (int k = 0; k < KEY_COUNT; k++) {
+        memcpy(liftRad[k], table.transitions[k][k].via, sizeof(liftRad[k]));
+    }
+    return 0;
+}
+
+// Compile every vote followed by the rest pose. With an arm each vote is cast as soon as it
+// is compiled, so the program only ever holds one vote; without one (--compile) the program
+// gets them all. Returns the moves that were late, or -1 if the link was lost for good
+long compilaVotos(const BallotStore* votos, BallotCache* cache, MotionProgram* program, NiryoArm* arm){
+    BallotView voto;
+    long i = 0, atrasados = 0, ret = 0;
+    while (ballot_store_next(votos, &i, &voto)) {
+        if (compilados != NULL) {
+            JournalEntry entrada = journal_entry(voto.offset, voto.digits, voto.length);
+            if (journal_contains(&diario, &entrada)) {
+                printf("Vote #%ld/%ld already cast\n", i, votos->count);
+                continue;
+            }
+            compilados[qtdCompilados++] = entrada;
+        }
+        if (arm != NULL) {
+            program_clear(program);
+        }
+        printf("Compiling vote #%ld/%ld = %s\n", i, votos->count, voto.digits);
+        ballot_cache_add_ballot(cache, program, &table, voto.digits, voto.length);
+        if (arm != NULL) {
+            if ((ret = program_run(arm, program)) == -1) {
+                return -1;
+            }
+            atrasados += ret;
+        }
+    }
+    if (arm != NULL) {
+        program_clear(program);
+    }
+    program_add_home(program, &table);
+    if (arm != NULL && (ret = program_run(arm, program)) == -1) {
+        return -1;
+    }
+    return atrasados + ret;
 }
 
 int main(int argc, char* argv[]) {
     printf("=== Niryo One Voting System (Alternative Implementation) ===\n");
     
-    char** votos = NULL;
-    int qtdVotos = 0;
+    BallotStore votos;
+    NiryoArm arm;
+    const char* arquivo = "votes.txt";
 
-    carregaVotos(&qtdVotos, &votos);
+    arm_init(&arm, SCENE_CHAIN);
+    if (arm_parse_options(&arm, argc, argv, &arquivo) == -1) {
+        return 1;
+    }
+    arm_report_on_signal(SIGUSR1);
 
-    int handler = 0;
+    // Compile every vote (or load a compiled program) before connecting
+    MotionProgram program;
+    if (buildKeyTables(arm.layoutFrom) == -1) {
+        return 1;
+    }
+    arm.keyHover = liftRad;
+    program_init(&program, SCENE_CHAIN);
+    if (arm.journalTo != NULL) {
+        if (arm.programFrom != NULL) {
+            printf("ERROR: --journal needs the votes file, not a compiled --program\n");
+            return 1;
+        }
+        if (journal_open(&diario, arm.journalTo) == -1) {
+            return 1;
+        }
+        printf("Journal %s: %ld vote(s) already cast\n", arm.journalTo, diario.count);
+        arm_ballot_observer = votoComputado;
+    }
+    BallotCache cache;
+    ballot_cache_init(&cache, (size_t)arm.ballotCacheKb * 1024);
+    ballot_store_init(&votos);
+    if (arm.programFrom != NULL) {
+        if (program_load(&program, arm.programFrom) == -1) {
+            return 1;
+        }
+    } else {
+        carregaVotos(arquivo, &votos);
+        if (arm.journalTo != NULL) {
+            compilados = (JournalEntry*)malloc((votos.count ? votos.count : 1) * sizeof(JournalEntry));
+        }
+    }
 
-    // Connect to CoppeliaSim
-    int clientID = simxStart((simxChar*)"127.0.0.1", 19999, true, true, 2000, 5);
-    extApi_sleepMs(500);
+    // --compile compiles every vote into one program; a run compiles each vote as it is cast
+    if (arm.compileTo != NULL) {
+        if (arm.programFrom == NULL) {
+            compilaVotos(&votos, &cache, &program, NULL);
+            ballot_cache_print(&cache);
+        }
+        printf("Motion program: %ld vote(s), %ld step(s), %ld redundant move(s) merged\n",
+               program.ballots, program.count, program.merged);
+        ballot_store_free(&votos);
+        ballot_cache_free(&cache);
+        if (program_save(&program, arm.compileTo) == -1) {
+            printf("ERROR: Could not write %s\n", arm.compileTo);
+            return 1;
+        }
+        printf("SUCCESS: Motion program written to %s\n", arm.compileTo);
+        program_free(&program);
+        return 0;
+    }
 
-    if (clientID == -1) {
+    // Connect to CoppeliaSim and resolve the six chain joints
+    if (arm_connect(&arm, arm.host, arm.port, 0) == -1) {
         printf("ERROR: Failed to connect to CoppeliaSim!\n");
         return 0;
     } else {
         printf("SUCCESS: Connected to CoppeliaSim!\n");
     }
-    
-    // Process each vote sequence
-    for (int i = 0; i < qtdVotos; i++) {
-        int k = strlen(votos[i]);
-        printf("Processing vote #%d/%d = %s\n", i + 1, qtdVotos, votos[i]);
-
-        // Process each digit in the vote sequence
-        for (int j = 0; j < k; j++) {
-            if (votos[i][j] == '1') {
-                simxChar handlerName1[150] = "/NiryoOne/Joint";
-
-                    simxGetObjectHandle(clientID, handlerName1, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)-0.20, (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)-0.84, (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)0.13, (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(3000);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)0.1, (simxInt)simx_opmode_oneshot_wait);
-            
-                    strcat(handlerName1, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName1, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    simxChar handlerNameR1[150] = "/NiryoOne/Joint";
-                    simxGetObjectHandle(clientID, handlerNameR1, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    Pos0(clientID,handler);
-                    
-                    strcat(handlerNameR1, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerNameR1, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    strcpy(handlerNameR1, "/NiryoOne/Joint");
-                    simxGetObjectHandle(clientID, handlerNameR1, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-                }
-
-                if (votos[i][j] == '2'){
-                    simxChar handlerName2[150] = "/NiryoOne/Joint";
-                    simxGetObjectHandle(clientID, handlerName2, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-20.8418), (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-63.5543), (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(0.205), (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-23.487), (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(64.3565), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(10.2405), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-
-                    strcat(handlerName2, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName2, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    strcpy(handlerName2, "/NiryoOne/Joint");
-                    simxGetObjectHandle(clientID, handlerName2, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    Pos0(clientID,handler);
-
-                    strcat(handlerName2, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName2, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    strcpy(handlerName2, "/NiryoOne/Joint");
-                    simxGetObjectHandle(clientID, handlerName2, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-                }
-
-                if (votos[i][j] == '3'){
-                    simxChar handlerName3[150] = "/NiryoOne/Joint";
-                    simxGetObjectHandle(clientID, handlerName3, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-27.5), (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-62.6473), (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(5.06), (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-31.9732), (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(60.6), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-    
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(16.6357), (simxInt)simx_opmode_oneshot_wait);
-
-                    strcat(handlerName3, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName3, &handler, (simxInt)simx_opmode_oneshot_wait);
 
-                    strcpy(handlerName3, "/NiryoOne/Joint/Link/Joint/Link/Joint/Link/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName3, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(55.6), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-
-                    strcpy(handlerName3, "/NiryoOne/Joint");
-                    simxGetObjectHandle(clientID, handlerName3, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    Pos0(clientID,handler);
-
-                    strcat(handlerName3, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName3, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    strcpy(handlerName3, "/NiryoOne/Joint");
-                    simxGetObjectHandle(clientID, handlerName3, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-                }
-                if (votos[i][j] == '4'){
-                    simxChar handlerName4[150] = "/NiryoOne/Joint";
-                    simxGetObjectHandle(clientID, handlerName4, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-18.1847), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-59.822), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-5.89), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-25.7076), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(66.7), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(10.42), (simxInt)simx_opmode_oneshot_wait);
-
-                    strcat(handlerName4, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName4, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    
-                    strcpy(handlerName4, "/NiryoOne/Joint/Link/Joint/Link/Joint/Link/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName4, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(60.13), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(1200);
-
-                    strcpy(handlerName4, "/NiryoOne/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName4, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    Pos0(clientID,handler);
-
-                    strcat(handlerName4, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName4, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    strcpy(handlerName4, "/NiryoOne/Joint");
-                    simxGetObjectHandle(clientID, handlerName4, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-                }
-                if (votos[i][j] == '5'){
-                    simxChar handlerName5[150] = "/NiryoOne/Joint";
-                    simxGetObjectHandle(clientID, handlerName5, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-23.4947), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-59.822), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-5.89), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-25.7076), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(66.7), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(10.42), (simxInt)simx_opmode_oneshot_wait);
-
-                    strcat(handlerName5, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName5, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    
-                    strcpy(handlerName5, "/NiryoOne/Joint/Link/Joint/Link/Joint/Link/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName5, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(58.53), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(1200);
-
-                    strcpy(handlerName5, "/NiryoOne/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName5, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    Pos0(clientID,handler);
-                        
-                    strcat(handlerName5, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName5, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    strcpy(handlerName5, "/NiryoOne/Joint");
-                    simxGetObjectHandle(clientID, handlerName5, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-                }
-                if (votos[i][j] == '6'){
-                    simxChar handlerName6[150] = "/NiryoOne/Joint";
-                    simxGetObjectHandle(clientID, handlerName6, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-28.803), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-64.357), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(1.269), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-31.967), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(65.53), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(14.065), (simxInt)simx_opmode_oneshot_wait);
-
-                    strcat(handlerName6, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName6, &handler, (simxInt)simx_opmode_oneshot_wait);
-                
-                    strcpy(handlerName6, "/NiryoOne/Joint/Link/Joint/Link/Joint/Link/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName6, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(61.53), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-
-                    strcpy(handlerName6, "/NiryoOne/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName6, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    Pos0(clientID,handler);
-
-                    strcat(handlerName6, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName6, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    strcpy(handlerName6, "/NiryoOne/Joint");
-                    simxGetObjectHandle(clientID, handlerName6, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-                }
-                if (votos[i][j] == '7'){
-                    simxChar handlerName7[150] = "/NiryoOne/Joint";
-                    simxGetObjectHandle(clientID, handlerName7, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-18.634), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-61.92), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-11.475), (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-19.0962), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(71.31), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(5.0745), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(3000);
-                        
-                    strcat(handlerName7, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName7, &handler, (simxInt)simx_opmode_oneshot_wait);
-                
-                    strcpy(handlerName7, "/NiryoOne/Joint/Link/Joint/Link/Joint/Link/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName7, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(68.53), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-
-                    strcpy(handlerName7, "/NiryoOne/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName7, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    Pos0(clientID,handler);
-                    
-                    strcat(handlerName7, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName7, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    strcpy(handlerName7, "/NiryoOne/Joint");
-                    simxGetObjectHandle(clientID, handlerName7, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-
-                }
-                if (votos[i][j] == '8'){
-                    simxChar handlerName8[150] = "/NiryoOne/Joint";
-                    simxGetObjectHandle(clientID, handlerName8, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-25.4769), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-64.028), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-7.61), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-26.8344), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(72.386), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(8.336), (simxInt)simx_opmode_oneshot_wait);
-
-                    strcat(handlerName8, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName8, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    
-                    strcpy(handlerName8, "/NiryoOne/Joint/Link/Joint/Link/Joint/Link/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName8, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(67.53), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-
-                    strcpy(handlerName8, "/NiryoOne/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName8, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    Pos0(clientID,handler);
-
-                    strcat(handlerName8, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName8, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    strcpy(handlerName8, "/NiryoOne/Joint");
-                    simxGetObjectHandle(clientID, handlerName8, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-                }
-                if (votos[i][j] == '9'){
-                    simxChar handlerName9[150] = "/NiryoOne/Joint";
-                    simxGetObjectHandle(clientID, handlerName9, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-29.88), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-65.2646), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-3.72), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-31.7808), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(70.96), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(11.02), (simxInt)simx_opmode_oneshot_wait);
-
-                    strcat(handlerName9, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName9, &handler, (simxInt)simx_opmode_oneshot_wait);
-                
-
-                    strcpy(handlerName9, "/NiryoOne/Joint/Link/Joint/Link/Joint/Link/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName9, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(65.53), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-
-                    strcpy(handlerName9, "/NiryoOne/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName9, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    Pos0(clientID,handler);
-
-                    strcat(handlerName9, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName9, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-
-                    strcpy(handlerName9, "/NiryoOne/Joint");
-                    simxGetObjectHandle(clientID, handlerName9, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-                }
-                if (votos[i][j] == '0'){
-                    simxChar handlerName0[150] = "/NiryoOne/Joint";
-                    simxGetObjectHandle(clientID, handlerName0, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-26.2714), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-66.9255), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(1000);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-10.075), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-26.9766), (simxInt)simx_opmode_oneshot_wait);
-                    
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(79.268), (simxInt)simx_opmode_oneshot_wait);
-                
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(5.994), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-
-                    strcat(handlerName0, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName0, &handler, (simxInt)simx_opmode_oneshot_wait);
-            
-                    strcpy(handlerName0, "/NiryoOne/Joint/Link/Joint/Link/Joint/Link/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName0, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(72.268), (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(2000);
-
-                    strcpy(handlerName0, "/NiryoOne/Joint/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName0, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    Pos0(clientID,handler);
-                
-                    strcat(handlerName0, "/Link/Joint");
-                    simxGetObjectHandle(clientID, (simxChar*)handlerName0, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-                    strcpy(handlerName0, "/NiryoOne/Joint");
-                    simxGetObjectHandle(clientID, handlerName0, &handler, (simxInt)simx_opmode_oneshot_wait);
-                    simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
-                    extApi_sleepMs(1000);
-                }
-            }
-
-        simxChar handlerNameConf[150] = "/NiryoOne/Joint";
-        simxGetObjectHandle(clientID, handlerNameConf, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-        simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-34.5314), (simxInt)simx_opmode_oneshot_wait);
-                
-        simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-72.956), (simxInt)simx_opmode_oneshot_wait);
-               
-        simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-2.79), (simxInt)simx_opmode_oneshot_wait);
-                
-        simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(-35.5412), (simxInt)simx_opmode_oneshot_wait);
-       
-        simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(75.24), (simxInt)simx_opmode_oneshot_wait);
-        extApi_sleepMs(2000);
-          
-        simxSetJointTargetPosition(clientID, handler, (simxFloat)radian(8.3587), (simxInt)simx_opmode_oneshot_wait);
-        extApi_sleepMs(1000);
-        
-        strcat(handlerNameConf, "/Link/Joint");
-        simxGetObjectHandle(clientID, (simxChar*)handlerNameConf, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-        strcpy(handlerNameConf, "/NiryoOne/Joint");
-        simxGetObjectHandle(clientID, handlerNameConf, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-        Pos0(clientID,handler);
-    
-        strcat(handlerNameConf, "/Link/Joint");
-        simxGetObjectHandle(clientID, (simxChar*)handlerNameConf, &handler, (simxInt)simx_opmode_oneshot_wait);
-
-        strcpy(handlerNameConf, "/NiryoOne/Joint");
-        simxGetObjectHandle(clientID, handlerNameConf, &handler, (simxInt)simx_opmode_oneshot_wait);
-        simxSetJointTargetPosition(clientID, handler, (simxFloat)0, (simxInt)simx_opmode_oneshot_wait);
+    // Press every key of every vote, then go back to the rest pose
+    long atrasados = arm.programFrom != NULL ? program_run(&arm, &program) : compilaVotos(&votos, &cache, &program, &arm);
+    if (atrasados == -1) {
+        printf("ERROR: Lost the link to CoppeliaSim for good, voting stopped\n");
     }
+    if (arm.programFrom == NULL) {
+        printf("Motion program: %ld vote(s) compiled one at a time, %ld redundant move(s) merged\n",
+               program.ballots, program.merged);
+        ballot_cache_print(&cache);
+    }
+    ballot_store_free(&votos);
+    ballot_cache_free(&cache);
+    program_free(&program);
 
     printf("fim da votacao!\n");
-    simxFinish(clientID);
+    arm_disconnect(&arm);
+    if (arm.journalTo != NULL) {
+        journal_close(&diario);
+        free(compilados);
+    }
+    arm_print_stats(&arm.stats, "Latency report (ms)");
 
+    if (arm.stats.failedBallots > 0) {
+        printf("ERROR: %ld vote(s) given up after a failed press, not confirmed\n", arm.stats.failedBallots);
+        return 1;
+    }
     return(0);
 }